@@ -0,0 +1,209 @@
+//
+//  dispatch.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include "dispatch.h"
+#include "engine.h"
+#include "scheduler.h"
+#include "search.h"
+#include "trace.h"
+
+/*
+ Tiered solving for workloads dominated by easy puzzles.
+
+ Most puzzles fall to naked singles alone. PropagateSingles() handles those
+ with one bitfield of solved values per row, column and square, and sweeps
+ only the cells that are still open, each losing the solved values of its
+ three units in one step. There is no pass over whole units, no cluster
+ enumeration and no timing, so an easy puzzle costs little more than a look at
+ its open cells.
+
+ Only a board on which singles stall goes on to the cluster logic of
+ SolveBoardScheduled(), and only a board on which that stalls goes on to
+ SearchBoard(). Each tier starts from the board the previous one left, so no
+ work is repeated, and the stats record which tier finished each puzzle.
+
+ Elimination only ever removes values that no solution can have, so a board
+ that singles or clusters solve has exactly one solution. Search looks for a
+ second one: a puzzle that has it is ambiguous and is left as the logic tiers
+ reduced it rather than reported with whichever solution was found first.
+ */
+
+
+/**
+ Remove the value of every solved cell from the other cells of its row,
+ column and square, following up on cells that become solved in turn, until
+ no such elimination is left.
+
+ @param board_ptr The board. Will be modified.
+ @return false if the board turned out to have no solution (a cell ran out of
+    values or two solved cells share a unit and a value); the board is then
+    only partly propagated.
+ */
+bool PropagateSingles(struct SudokuBoard *board_ptr) {
+    unsigned int row_solved[kMaxNumber], col_solved[kMaxNumber], square_solved[kMaxNumber];
+    uint8_t open[kMaxNumber * kMaxNumber];
+    int num_open = 0;
+
+    memset(row_solved, 0, sizeof row_solved);
+    memset(col_solved, 0, sizeof col_solved);
+    memset(square_solved, 0, sizeof square_solved);
+
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int row = cell / kMaxNumber;
+        int col = cell % kMaxNumber;
+        int square = row / kCellsPerSide * kCellsPerSide + col / kCellsPerSide;
+        unsigned int bits = board_ptr->cells[row][col].possibles;
+
+        if (bits == 0)
+            return false;
+        if ((bits & (bits - 1)) != 0) {
+            open[num_open++] = (uint8_t) cell;
+            continue;
+        }
+        if ((row_solved[row] | col_solved[col] | square_solved[square]) & bits)
+            return false;
+        row_solved[row] |= bits;
+        col_solved[col] |= bits;
+        square_solved[square] |= bits;
+    }
+
+    // Sweep the open cells until no new cell gets solved. Cells solved in a
+    // sweep leave the list; a sweep that solves nothing changes no mask, so
+    // another would find nothing either.
+    SetTraceContext(kTraceSingles, kTraceNoUnit);
+    bool progress;
+    do {
+        int num_kept = 0;
+        progress = false;
+
+        for (int index = 0; index < num_open; ++index) {
+            int cell = open[index];
+            int row = cell / kMaxNumber;
+            int col = cell % kMaxNumber;
+            int square = row / kCellsPerSide * kCellsPerSide + col / kCellsPerSide;
+            unsigned int bits = board_ptr->cells[row][col].possibles;
+            unsigned int remaining = bits & ~(row_solved[row] | col_solved[col] | square_solved[square]);
+
+            if (remaining == 0)
+                return false;
+            if (remaining != bits)
+                SetCellPossibles(board_ptr, row, col, remaining);
+
+            if ((remaining & (remaining - 1)) == 0) {
+                row_solved[row] |= remaining;
+                col_solved[col] |= remaining;
+                square_solved[square] |= remaining;
+                progress = true;
+            }
+            else {
+                open[num_kept++] = (uint8_t) cell;
+            }
+        }
+        num_open = num_kept;
+    } while (progress);
+
+    return true;
+}
+
+
+/**
+ Reset all counters.
+
+ @param stats The stats to initialize.
+ */
+void InitDispatchStats(struct DispatchStats *stats) {
+    stats->puzzles = 0;
+    for (int tier = 0; tier < kNumDispatchTiers; ++tier)
+        stats->solved[tier] = 0;
+    stats->unsolved = 0;
+    stats->ambiguous = 0;
+}
+
+
+/**
+ Add the counters of one set of stats to another, e.g. to combine workers.
+
+ @param total The stats to add to.
+ @param part The stats to add.
+ */
+void AddDispatchStats(struct DispatchStats *total, struct DispatchStats const *part) {
+    total->puzzles += part->puzzles;
+    for (int tier = 0; tier < kNumDispatchTiers; ++tier)
+        total->solved[tier] += part->solved[tier];
+    total->unsolved += part->unsolved;
+    total->ambiguous += part->ambiguous;
+}
+
+
+/**
+ Solve a board with the cheapest tier that finishes it: singles, then
+ clusters, then search.
+
+ @param board_ptr The board. Overwritten with the solution if it is unique,
+ otherwise with the board as far as singles and clusters reduced it.
+ @param scheduler The scheduler for the cluster tier, which learns across boards.
+ @param stats Counts the puzzle under the tier that finished it.
+ @return true if the board was solved; false if it has no solution or more than one.
+ */
+bool SolveBoardTiered(struct SudokuBoard *board_ptr, struct SolveScheduler *scheduler, struct DispatchStats *stats) {
+    ++stats->puzzles;
+
+    if (!PropagateSingles(board_ptr)) {
+        ++stats->unsolved;
+        return false;
+    }
+    if (IsBoardSolved(board_ptr)) {
+        ++stats->solved[kTierSingles];
+        return true;
+    }
+
+    SolveBoardScheduled(board_ptr, scheduler);
+    if (IsBoardContradictory(board_ptr)) {
+        ++stats->unsolved;
+        return false;
+    }
+    if (IsBoardSolved(board_ptr)) {
+        ++stats->solved[kTierClusters];
+        return true;
+    }
+
+    struct SudokuBoard reduced = *board_ptr;
+    struct SearchOptions options = DefaultSearchOptions();
+    options.max_solutions = 2;
+    int num_solutions = SearchBoard(board_ptr, &options).num_solutions;
+    if (num_solutions == 0) {
+        ++stats->unsolved;
+        return false;
+    }
+    if (num_solutions > 1) {
+        *board_ptr = reduced;
+        ++stats->ambiguous;
+        return false;
+    }
+    ++stats->solved[kTierSearch];
+    return true;
+}
+
+
+/**
+ Print how many puzzles each tier finished.
+
+ @param stats The stats.
+ @param stream The stream to print to.
+ */
+void PrintDispatchStats(struct DispatchStats const *stats, FILE *stream) {
+    static char const *names[kNumDispatchTiers] = {"singles", "clusters", "search"};
+    double scale = stats->puzzles > 0 ? 100.0 / stats->puzzles : 0.0;
+
+    for (int tier = 0; tier < kNumDispatchTiers; ++tier)
+        fprintf(stream, "%-9s %10ld puzzles  %5.1f%%\n", names[tier], stats->solved[tier], scale * stats->solved[tier]);
+    fprintf(stream, "%-9s %10ld puzzles  %5.1f%%\n", "unsolved", stats->unsolved, scale * stats->unsolved);
+    fprintf(stream, "%-9s %10ld puzzles  %5.1f%%\n", "ambiguous", stats->ambiguous, scale * stats->ambiguous);
+}
@@ -0,0 +1,40 @@
+//
+//  dispatch.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef dispatch_h
+#define dispatch_h
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "engine.h"
+#include "scheduler.h"
+
+/**
+ The stages of SolveBoardTiered(), cheapest first.
+ */
+enum DispatchTier {
+    kTierSingles,    // PropagateSingles()
+    kTierClusters,   // SolveBoardScheduled()
+    kTierSearch,     // SearchBoard()
+    kNumDispatchTiers
+};
+
+struct DispatchStats {
+    long puzzles;
+    long solved[kNumDispatchTiers];  // puzzles finished by each tier
+    long unsolved;                   // puzzles without a solution
+    long ambiguous;                  // puzzles with more than one solution
+};
+
+bool PropagateSingles(struct SudokuBoard *board_ptr);
+void InitDispatchStats(struct DispatchStats *stats);
+void AddDispatchStats(struct DispatchStats *total, struct DispatchStats const *part);
+bool SolveBoardTiered(struct SudokuBoard *board_ptr, struct SolveScheduler *scheduler, struct DispatchStats *stats);
+void PrintDispatchStats(struct DispatchStats const *stats, FILE *stream);
+
+#endif /* dispatch_h */
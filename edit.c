@@ -0,0 +1,258 @@
+//
+//  edit.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "edit.h"
+#include "engine.h"
+#include "trace.h"
+
+/*
+ Incremental re-solving for editors that change one clue at a time.
+
+ Every elimination is tagged with the set of clues it was derived from: a
+ clue's own cell loses its other values because of that clue alone, and a
+ cluster's eliminations depend on every clue behind every value already ruled
+ out of the cluster's cells (and of earlier clusters found in the same pass
+ over the unit, which the later ones may rely on). Sets may be larger than
+ strictly needed but never miss a clue, which is what makes undo safe.
+
+ Clearing a clue puts back exactly the values whose elimination depended on
+ it and re-examines only the units of the cells that changed. Setting a clue
+ propagates from the clue's own units. The work therefore follows what the
+ edit actually affects rather than the size of the board.
+ */
+
+
+/**
+ Add a cell to a clue set.
+
+ @param set The set.
+ @param cell Cell number (row * kMaxNumber + col).
+ */
+static void ClueSetAdd(struct ClueSet *set, int cell) {
+    set->bits[cell / 64] |= (uint64_t) 1 << (cell % 64);
+}
+
+
+/**
+ Return whether a clue set contains a cell.
+
+ @param set The set.
+ @param cell Cell number (row * kMaxNumber + col).
+ @return true if the cell is in the set.
+ */
+static bool ClueSetContains(struct ClueSet const *set, int cell) {
+    return (set->bits[cell / 64] >> (cell % 64)) & 1;
+}
+
+
+/**
+ Add all members of one clue set to another.
+
+ @param set The set to extend.
+ @param other The set to add.
+ */
+static void ClueSetUnion(struct ClueSet *set, struct ClueSet const *other) {
+    set->bits[0] |= other->bits[0];
+    set->bits[1] |= other->bits[1];
+}
+
+
+/**
+ Start with an empty board: no clues, every value possible everywhere.
+
+ @param edit_ptr The board to initialize.
+ */
+void InitEditableBoard(struct EditableBoard *edit_ptr) {
+    ClearBoard(&edit_ptr->board);
+    memset(edit_ptr->clues, 0, sizeof edit_ptr->clues);
+    memset(edit_ptr->reasons, 0, sizeof edit_ptr->reasons);
+    SetBooleanArray(edit_ptr->pending, 3 * kMaxNumber, false);
+    edit_ptr->units_examined = 0;
+}
+
+
+/**
+ Mark the three units of a cell for re-examination.
+
+ @param edit_ptr The board under edit.
+ @param row Row of the changed cell.
+ @param col Column of the changed cell.
+ */
+static void MarkCellChanged(struct EditableBoard *edit_ptr, int row, int col) {
+    edit_ptr->pending[row] = true;
+    edit_ptr->pending[kMaxNumber + col] = true;
+    edit_ptr->pending[2 * kMaxNumber + RowAndColToSquare(row, col)] = true;
+}
+
+
+/**
+ Add to set every clue behind the current state of a cell: the cell's own
+ clue and the reasons of every value ruled out of it.
+
+ @param edit_ptr The board under edit.
+ @param row Row of the cell.
+ @param col Column of the cell.
+ @param set The set to extend.
+ */
+static void AddCellReasons(struct EditableBoard const *edit_ptr, int row, int col, struct ClueSet *set) {
+    int cell = row * kMaxNumber + col;
+    int possibles = edit_ptr->board.cells[row][col].possibles;
+
+    if (edit_ptr->clues[cell] != 0)
+        ClueSetAdd(set, cell);
+
+    for (int digit = 1; digit <= kMaxNumber; ++digit)
+        if (!(possibles & (1 << (digit - 1))))
+            ClueSetUnion(set, &edit_ptr->reasons[cell][digit - 1]);
+}
+
+
+/**
+ Apply the clusters of one unit, tagging every elimination with its reasons.
+
+ @param edit_ptr The board under edit.
+ @param unit The unit, as in GetUnitCells().
+ */
+static void ExamineUnit(struct EditableBoard *edit_ptr, int unit) {
+    struct SudokuCell cells[kMaxNumber];
+    struct ClueSet reasons = {{0, 0}};
+    int row, col;
+
+    ++edit_ptr->units_examined;
+    SetTraceContext(kTraceClusters, unit);
+    GetUnitCells(&edit_ptr->board, unit, cells);
+    struct LineClusterGroups clusters = FindLineClusters(cells);
+
+    for (int cluster_num = 0; cluster_num < clusters.size; ++cluster_num) {
+        struct LineCluster cluster = clusters.clusters[cluster_num];
+        bool is_cluster_position[kMaxNumber];
+        SetBooleanArray(is_cluster_position, kMaxNumber, false);
+
+        for (int index = 0; index < cluster.size; ++index) {
+            is_cluster_position[cluster.positions[index]] = true;
+            UnitCellPosition(unit, cluster.positions[index], &row, &col);
+            AddCellReasons(edit_ptr, row, col, &reasons);
+        }
+
+        for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+            UnitCellPosition(unit, cell_index, &row, &col);
+            int possibles = edit_ptr->board.cells[row][col].possibles;
+            int removed = possibles & cluster.bitset;
+            if (is_cluster_position[cell_index] || removed == 0)
+                continue;
+
+            int cell = row * kMaxNumber + col;
+            for (int digit = 1; digit <= kMaxNumber; ++digit)
+                if (removed & (1 << (digit - 1)))
+                    edit_ptr->reasons[cell][digit - 1] = reasons;
+
+            SetCellPossibles(&edit_ptr->board, row, col, possibles & ~removed);
+            MarkCellChanged(edit_ptr, row, col);
+        }
+    }
+
+    FreeLineClusterGroups(&clusters);
+}
+
+
+/**
+ Examine pending units until none is left.
+
+ @param edit_ptr The board under edit.
+ */
+static void Propagate(struct EditableBoard *edit_ptr) {
+    bool found;
+
+    do {
+        found = false;
+        for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+            if (edit_ptr->pending[unit]) {
+                edit_ptr->pending[unit] = false;
+                ExamineUnit(edit_ptr, unit);
+                found = true;
+            }
+        }
+    } while (found);
+}
+
+
+/**
+ Remove the clue in a cell, if any, undo every elimination that depended on
+ it and propagate again from the cells that changed.
+
+ @param edit_ptr The board under edit.
+ @param row Row on sudoku board (0, ..., kMaxNumber - 1)
+ @param col Column on sudoku board (0, ..., kMaxNumber - 1)
+ */
+void EditClearClue(struct EditableBoard *edit_ptr, int row, int col) {
+    int clue_cell = row * kMaxNumber + col;
+
+    if (edit_ptr->clues[clue_cell] == 0)
+        return;
+    edit_ptr->clues[clue_cell] = 0;
+    SetTraceContext(kTraceUndo, kTraceNoUnit);
+
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int cell_row = cell / kMaxNumber;
+        int cell_col = cell % kMaxNumber;
+        int possibles = edit_ptr->board.cells[cell_row][cell_col].possibles;
+        int restored = 0;
+
+        for (int digit = 1; digit <= kMaxNumber; ++digit) {
+            struct ClueSet *reasons = &edit_ptr->reasons[cell][digit - 1];
+            if (!(possibles & (1 << (digit - 1))) && ClueSetContains(reasons, clue_cell)) {
+                restored |= 1 << (digit - 1);
+                reasons->bits[0] = reasons->bits[1] = 0;
+            }
+        }
+
+        if (restored != 0) {
+            SetCellPossibles(&edit_ptr->board, cell_row, cell_col, possibles | restored);
+            MarkCellChanged(edit_ptr, cell_row, cell_col);
+        }
+    }
+
+    Propagate(edit_ptr);
+}
+
+
+/**
+ Put a clue in a cell, replacing any clue already there, and propagate its
+ consequences.
+
+ @param edit_ptr The board under edit.
+ @param row Row on sudoku board (0, ..., kMaxNumber - 1)
+ @param col Column on sudoku board (0, ..., kMaxNumber - 1)
+ @param value The value of the clue (1, ..., kMaxNumber).
+ */
+void EditSetClue(struct EditableBoard *edit_ptr, int row, int col, unsigned int value) {
+    int cell = row * kMaxNumber + col;
+
+    if (edit_ptr->clues[cell] == (int) value)
+        return;
+    EditClearClue(edit_ptr, row, col);
+
+    edit_ptr->clues[cell] = value;
+
+    // Every other value is now ruled out by this clue alone, so the cell
+    // cannot regain values while the clue stands. If the clue's own value had
+    // already been ruled out, the puzzle is contradictory and the clue wins.
+    for (int digit = 1; digit <= kMaxNumber; ++digit) {
+        struct ClueSet *reasons = &edit_ptr->reasons[cell][digit - 1];
+        reasons->bits[0] = reasons->bits[1] = 0;
+        if (digit != (int) value)
+            ClueSetAdd(reasons, cell);
+    }
+
+    SetTraceContext(kTraceInput, kTraceNoUnit);
+    SetCellPossibles(&edit_ptr->board, row, col, 1 << (value - 1));
+    MarkCellChanged(edit_ptr, row, col);
+    Propagate(edit_ptr);
+}
@@ -0,0 +1,41 @@
+//
+//  edit.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef edit_h
+#define edit_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+
+/**
+ Set of clue cells, one bit per cell (row * kMaxNumber + col).
+ */
+struct ClueSet {
+    uint64_t bits[2];
+};
+
+/**
+ A board under edit. board always holds the elimination result for the
+ current clues. For every value ruled out of a cell, reasons records the clues
+ that the elimination depended on, so that removing a clue undoes exactly the
+ eliminations that relied on it.
+ */
+struct EditableBoard {
+    struct SudokuBoard board;
+    int clues[81];                   // value of the clue in each cell; 0 for none
+    struct ClueSet reasons[81][9];   // per cell and value (value - 1)
+    bool pending[27];                // units to re-examine, as in GetUnitCells()
+    long units_examined;             // work counter, for measuring edits
+};
+
+void InitEditableBoard(struct EditableBoard *edit_ptr);
+void EditSetClue(struct EditableBoard *edit_ptr, int row, int col, unsigned int value);
+void EditClearClue(struct EditableBoard *edit_ptr, int row, int col);
+
+#endif /* edit_h */
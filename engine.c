@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "engine.h"
+#include "layout.h"
+#include "trace.h"
 
 /**
  The classic sudoku puzzle is divided into 9 squares of 9 cells. That is,
@@ -35,6 +37,21 @@ const int kMaxNumber = kCellsPerSide * kCellsPerSide;
 const int kAllBits = (1 << kMaxNumber) - 1;
 
 
+/**
+ Reset all cells of the board to be blank (i.e., bitfield = kAllBits). Any
+ trail is detached; the reset itself is not recorded.
+
+ @param board_ptr Pointer to struct SudokuBoard. Will be overwritten.
+ */
+void ClearBoard(struct SudokuBoard *board_ptr) {
+    for (int row = 0; row < kMaxNumber; ++row)
+        for (int col = 0; col < kMaxNumber; ++col)
+            ((board_ptr->cells)[row][col]).possibles = kAllBits; // kMaxNumber 1s
+    
+    board_ptr->trail = NULL;
+}
+
+
 /**
  Allocate Sudoku board on heap, initialize all cells to be blank (i.e., 
  bitfield = kAllBits) and return pointer to the board.
@@ -44,9 +61,7 @@ const int kAllBits = (1 << kMaxNumber) - 1;
 struct SudokuBoard * blank_board() {
     struct SudokuBoard *board_ptr = malloc(sizeof(struct SudokuBoard));
     
-    for (int row = 0; row < kMaxNumber; ++row)
-        for (int col = 0; col < kMaxNumber; ++col)
-            ((board_ptr->cells)[row][col]).possibles = kAllBits; // kMaxNumber 1s
+    ClearBoard(board_ptr);
     
     return board_ptr;
 }
@@ -59,6 +74,9 @@ struct SudokuBoard * blank_board() {
  @return int specifying number of bits set in bitfield
  */
 int BitCount(int bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount((unsigned int) bits);
+#else
     int bit_count = 0;
     
     while (bits != 0) {
@@ -67,6 +85,7 @@ int BitCount(int bits) {
     }
     
     return bit_count;
+#endif
 }
 
 /**
@@ -76,20 +95,23 @@ int BitCount(int bits) {
  @return -1 if multiple values are possible for the cell; otherwise the only possible value.
  */
 int SinglePossible(struct SudokuCell cell) {
-    int found = -1;
-    int found_count = 0;
+    unsigned int bits = cell.possibles;
     
-    for (int digit = 1; digit <= kMaxNumber; ++digit) {
-        if (cell.possibles & (1 << (digit - 1))) {
-            found = digit;
-            ++found_count;
-        }
-    }
+    if (bits == 0 || (bits & (bits - 1)) != 0)
+        return -1;
     
-    if (found_count > 1)
-        found = -1;
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits) + 1;
+#else
+    int found = 1;
+    
+    while (!(bits & 1)) {
+        bits >>= 1;
+        ++found;
+    }
     
     return found;
+#endif
 }
 
 /**
@@ -104,7 +126,104 @@ int SinglePossible(struct SudokuCell cell) {
               Must be between 1 and kMaxNumber.
  */
 void SetCell(struct SudokuBoard *board_ptr, int row, int col, unsigned int value) {
-    (board_ptr->cells)[row][col].possibles = 1 << (value - 1);
+    SetCellPossibles(board_ptr, row, col, 1 << (value - 1));
+}
+
+
+/**
+ Overwrite the possible values of the specified cell. Every change to the cells
+ of a board goes through here, which records the old value on the board's
+ trail if one is attached, and records the change in the calling thread's
+ trace ring if one is attached.
+
+ @param board_ptr Pointer to struct SudokuBoard
+ @param row Row on sudoku board (0, ..., kMaxNumber - 1)
+ @param col Column on sudoku board (0, ..., kMaxNumber - 1)
+ @param possibles Bitfield of the values still possible for the cell.
+ */
+void SetCellPossibles(struct SudokuBoard *board_ptr, int row, int col, unsigned int possibles) {
+    unsigned int old_possibles = board_ptr->cells[row][col].possibles;
+    
+    if (old_possibles == possibles)
+        return;
+    
+    struct Trail *trail = board_ptr->trail;
+    if (trail != NULL) {
+        if (trail->size == trail->capacity) {
+            trail->capacity = trail->capacity > 0 ? 2 * trail->capacity : 256;
+            trail->entries = realloc(trail->entries, trail->capacity * sizeof(struct TrailEntry));
+        }
+        trail->entries[trail->size].cell = (short) (row * kMaxNumber + col);
+        trail->entries[trail->size].possibles = (unsigned short) old_possibles;
+        ++trail->size;
+    }
+    
+    if (current_trace_ring != NULL)
+        RecordTraceEvent(row * kMaxNumber + col, old_possibles, possibles);
+
+    (board_ptr->cells)[row][col].possibles = possibles;
+}
+
+
+/**
+ Initialize an empty trail. A trail is an undo log: attached to a board (by
+ setting board_ptr->trail) it records the old value of every cell changed
+ through SetCellPossibles(), which covers SetCell() and SetCellsOn*().
+
+ @param trail The trail to initialize.
+ */
+void InitTrail(struct Trail *trail) {
+    trail->entries = NULL;
+    trail->size = 0;
+    trail->capacity = 0;
+}
+
+
+/**
+ Release the memory held by a trail.
+
+ @param trail The trail. Will be emptied.
+ */
+void FreeTrail(struct Trail *trail) {
+    free(trail->entries);
+    InitTrail(trail);
+}
+
+
+/**
+ Return a checkpoint for the board's trail: the position to which
+ RestoreCheckpoint() can later roll the board back.
+
+ @param board_ptr Pointer to struct SudokuBoard with a trail attached.
+ @return The checkpoint.
+ */
+int MarkCheckpoint(struct SudokuBoard const *board_ptr) {
+    return board_ptr->trail->size;
+}
+
+
+/**
+ Undo every change recorded since the checkpoint, newest first. Takes time
+ proportional to the number of changes undone, not to the size of the board.
+
+ @param board_ptr Pointer to struct SudokuBoard with a trail attached. Will be modified.
+ @param checkpoint A checkpoint from MarkCheckpoint() that has not been rolled back past.
+ */
+void RestoreCheckpoint(struct SudokuBoard *board_ptr, int checkpoint) {
+    struct Trail *trail = board_ptr->trail;
+    
+    if (current_trace_ring != NULL)
+        SetTraceContext(kTraceUndo, kTraceNoUnit);
+
+    while (trail->size > checkpoint) {
+        struct TrailEntry entry = trail->entries[--trail->size];
+        int row = entry.cell / kMaxNumber;
+        int col = entry.cell % kMaxNumber;
+        
+        if (current_trace_ring != NULL)
+            RecordTraceEvent(entry.cell, board_ptr->cells[row][col].possibles, entry.possibles);
+        board_ptr->cells[row][col].possibles = entry.possibles;
+    }
 }
 
 
@@ -148,6 +267,119 @@ void PrintBoard(struct SudokuBoard *board_ptr) {
 }
 
 
+/**
+ Fill the board from a string of kMaxNumber * kMaxNumber characters, read row
+ by row. The digits 1, ..., kMaxNumber are clues; '.' and '0' mark blank cells.
+ 
+ Assumes kMaxNumber <= 9 so that every cell is a single character.
+
+ @param board_ptr Pointer to struct SudokuBoard. Will be overwritten.
+ @param text The puzzle text. Need not be null-terminated.
+ @return true if the text was well-formed; otherwise false (the board is then undefined).
+ */
+bool BoardFromString(struct SudokuBoard *board_ptr, char const *text) {
+    ClearBoard(board_ptr);
+    SetTraceContext(kTraceInput, kTraceNoUnit);
+    
+    for (int row = 0; row < kMaxNumber; ++row) {
+        for (int col = 0; col < kMaxNumber; ++col) {
+            char symbol = text[row * kMaxNumber + col];
+            
+            if (symbol == '.' || symbol == '0')
+                continue;
+            else if (symbol >= '1' && symbol <= '0' + kMaxNumber)
+                SetCell(board_ptr, row, col, (unsigned int) (symbol - '0'));
+            else
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+
+/**
+ Write the board as kMaxNumber * kMaxNumber characters, row by row, in the
+ format read by BoardFromString(). Cells with more than one possible value are
+ written as '.'. No null terminator is written.
+
+ @param board_ptr Pointer to struct SudokuBoard.
+ @param text Output buffer of at least kMaxNumber * kMaxNumber characters.
+ */
+void BoardToString(struct SudokuBoard const *board_ptr, char *text) {
+    for (int row = 0; row < kMaxNumber; ++row) {
+        for (int col = 0; col < kMaxNumber; ++col) {
+            int val = SinglePossible(board_ptr->cells[row][col]);
+            text[row * kMaxNumber + col] = (val == -1) ? '.' : (char) ('0' + val);
+        }
+    }
+}
+
+
+/**
+ Return whether every cell on the board has been reduced to a single possible value.
+
+ @param board_ptr Pointer to struct SudokuBoard.
+ @return true if the board is solved.
+ */
+bool IsBoardSolved(struct SudokuBoard const *board_ptr) {
+    for (int row = 0; row < kMaxNumber; ++row)
+        for (int col = 0; col < kMaxNumber; ++col)
+            if (SinglePossible(board_ptr->cells[row][col]) == -1)
+                return false;
+    
+    return true;
+}
+
+
+/**
+ Return whether a unit can no longer be completed: some cell has no possible
+ value left, the unit has no room left for some value, or two solved cells
+ share a value.
+
+ @param cells The kMaxNumber cells of the unit.
+ @return true if the unit has no solution.
+ */
+bool IsUnitContradictory(struct SudokuCell const cells[kMaxNumber]) {
+    int all_bits = 0;
+    int solved_bits = 0;
+    
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles;
+        if (bits == 0)
+            return true;
+        if ((bits & (bits - 1)) == 0) {
+            if (solved_bits & bits)
+                return true;
+            solved_bits |= bits;
+        }
+        all_bits |= bits;
+    }
+    
+    return all_bits != kAllBits;
+}
+
+
+/**
+ Return whether the board can no longer be completed because one of its
+ units cannot (see IsUnitContradictory()).
+
+ @param board_ptr Pointer to struct SudokuBoard.
+ @return true if the board has no solution.
+ */
+bool IsBoardContradictory(struct SudokuBoard const *board_ptr) {
+    struct SudokuCell cells[kMaxNumber];
+    
+    for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+        GetUnitCells(board_ptr, unit, cells);
+        if (IsUnitContradictory(cells))
+            return true;
+    }
+    
+    return false;
+}
+
+
 /**
  Set all values in a Boolean array to the specified value.
 
@@ -199,39 +431,84 @@ struct SudokuCell *CellsFromSquare(struct SudokuBoard const *board_ptr, int squa
 
 
 /**
- Return all cells in a row in the sequence of col = 0, ..., kMaxNumber as
- an array.
+ Copy the cells of a unit into the array cells. Units are numbered
+ 0, ..., 3 * kMaxNumber - 1: first the rows, then the columns, then the squares
+ (numbered as in RowAndColToSquare()). Cells of a row or column are ordered
+ along it; cells of a square are ordered as in CellsFromSquare().
+ 
+ Unlike CellsFromSquare(), nothing is allocated.
 
  @param board_ptr Pointer to the sudoku board.
- @param row The row from which to return the cells.
- @return Pointer to first element of array of cells. Length is kMaxNumber.
+ @param unit The unit number.
+ @param cells Array of kMaxNumber cells to receive the unit.
  */
-struct SudokuCell *CellsFromRow(struct SudokuBoard *board_ptr, int row) {
-    struct SudokuCell *cell_ptr = malloc(kMaxNumber * sizeof(struct SudokuCell));
-    
-    for (int col = 0; col < kMaxNumber; ++col)
-        cell_ptr[col] = board_ptr->cells[row][col];
+void GetUnitCells(struct SudokuBoard const *board_ptr, int unit, struct SudokuCell cells[kMaxNumber]) {
+    int row, col;
     
-    return cell_ptr;
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        UnitCellPosition(unit, cell_index, &row, &col);
+        cells[cell_index] = board_ptr->cells[row][col];
+    }
 }
 
+
 /**
- Return all cells in a column in the sequence of row = 0, ..., kMaxNumber as
- an array.
- 
- @param board_ptr Pointer to the sudoku board.
- @param col The column from which to return the cells.
- @return Pointer to first element of array of cells. Length is kMaxNumber.
+ Overwrite the cells of a unit on the board. The inverse of GetUnitCells().
+
+ @param board_ptr Pointer to the sudoku board. Will be modified.
+ @param unit The unit number as in GetUnitCells().
+ @param cells Array of kMaxNumber cells.
  */
-struct SudokuCell *CellsFromColumn(struct SudokuBoard *board_ptr, int col) {
-    struct SudokuCell *cell_ptr = malloc(kMaxNumber * sizeof(struct SudokuCell));
-    
-    for (int row = 0; row < kMaxNumber; ++row)
-        cell_ptr[row] = board_ptr->cells[row][col];
+void SetUnitCells(struct SudokuBoard *board_ptr, int unit, struct SudokuCell const cells[kMaxNumber]) {
+    if (unit < kMaxNumber)
+        SetCellsOnRow(board_ptr, cells, unit);
+    else if (unit < 2 * kMaxNumber)
+        SetCellsOnColumn(board_ptr, cells, unit - kMaxNumber);
+    else
+        SetCellsOnSquare(board_ptr, cells, unit - 2 * kMaxNumber);
+}
+
+
+/**
+ Return the board position of the cell_index'th cell of a unit.
+
+ @param unit The unit number as in GetUnitCells().
+ @param cell_index Index of the cell within the unit (0, ..., kMaxNumber - 1).
+ @param row_ptr Receives the row on the board.
+ @param col_ptr Receives the column on the board.
+ */
+void UnitCellPosition(int unit, int cell_index, int *row_ptr, int *col_ptr) {
+    if (unit < kMaxNumber) {
+        *row_ptr = unit;
+        *col_ptr = cell_index;
+    }
+    else if (unit < 2 * kMaxNumber) {
+        *row_ptr = cell_index;
+        *col_ptr = unit - kMaxNumber;
+    }
+    else {
+        int square_num = unit - 2 * kMaxNumber;
+        *row_ptr = (square_num / kCellsPerSide) * kCellsPerSide + cell_index / kCellsPerSide;
+        *col_ptr = (square_num % kCellsPerSide) * kCellsPerSide + cell_index % kCellsPerSide;
+    }
+}
+
+
+/**
+ Release the memory held by the result of FindLineClusters().
+
+ @param groups The cluster groups. Will be emptied.
+ */
+void FreeLineClusterGroups(struct LineClusterGroups *groups) {
+    for (int cluster_num = 0; cluster_num < groups->size; ++cluster_num)
+        free(groups->clusters[cluster_num].positions);
+    free(groups->clusters);
     
-    return cell_ptr;
+    groups->size = 0;
+    groups->clusters = NULL;
 }
 
+
 /**
  Given an array of sudoku cells and information about the clustering therein,
  filter the possible values of each cell in place.
@@ -256,68 +533,18 @@ void FilterCellsByClusters(struct SudokuCell cells[kMaxNumber], struct LineClust
 }
 
 
-/**
- Return simple hash for sudoku board. If s1 and s2 are states of the same board 
- but s2 is in a more solved state than s1 (i.e., for each cell, the number of 
- possible values in s2 is less than or equal to that of s1 with strict inequality
- in at least one case) the checksums are guaranteed to be different.
- 
- @param board_ptr Pointer to sudoku board.
- @return Integer (hash).
- */
-int BoardCheckSum(struct SudokuBoard const *board_ptr) {
-    int checksum = 0;
-    
-    for (int row = 0; row < kMaxNumber; ++row) {
-        for (int col = 0; col < kMaxNumber; ++col) {
-            checksum += BitCount(board_ptr->cells[row][col].possibles);
-        }
-    }
-    
-    return checksum;
-}
-
-
 /**
  Reduce possibilities in each cell as much as possibly with the hope
  (but not guarantee) of reducing each cell to a single possible number.
+ The classic case of SolveBoardWithLayout().
 
  @param board_ptr Pointer to the suduko puzzle to be solved. The board will be modified.
  */
 void SolveBoard(struct SudokuBoard *board_ptr) {
-    int checksum, last_checksum;
-    checksum = BoardCheckSum(board_ptr);
-    do {
-        last_checksum = checksum;
-        
-        for (int row = 0; row < kMaxNumber; ++row) {
-            struct SudokuCell *cells = CellsFromRow(board_ptr, row);
-            struct LineClusterGroups clusters = FindLineClusters(cells);
-            FilterCellsByClusters(cells, &clusters);
-            
-            SetCellsOnRow(board_ptr, cells, row);
-            free(cells);
-        }
-        
-        for (int col = 0; col < kMaxNumber; ++col) {
-            struct SudokuCell *cells = CellsFromColumn(board_ptr, col);
-            struct LineClusterGroups clusters = FindLineClusters(cells);
-            FilterCellsByClusters(cells, &clusters);
-            
-            SetCellsOnColumn(board_ptr, cells, col);
-            free(cells);
-        }
-        
-        for (int square_num = 0; square_num < kMaxNumber; ++square_num) {
-            struct SudokuCell *cells = CellsFromSquare(board_ptr, square_num);
-            struct LineClusterGroups clusters = FindLineClusters(cells);
-            FilterCellsByClusters(cells, &clusters);
-            
-            SetCellsOnSquare(board_ptr, cells, square_num);
-            free(cells);
-        }
-        checksum = BoardCheckSum(board_ptr);
-    } while (checksum != last_checksum);
+    struct UnitLayout layout;
+    
+    InitClassicLayout(&layout);
+    SolveBoardWithLayout(board_ptr, &layout);
 }
 
 
@@ -333,7 +560,7 @@ void SolveBoard(struct SudokuBoard *board_ptr) {
  */
 void SetCellsOnRow(struct SudokuBoard *board_ptr, struct SudokuCell const cells[kMaxNumber], int row) {
     for (int col = 0; col < kMaxNumber; ++col)
-        board_ptr->cells[row][col].possibles = cells[col].possibles;
+        SetCellPossibles(board_ptr, row, col, cells[col].possibles);
 }
 
 /**
@@ -348,7 +575,7 @@ void SetCellsOnRow(struct SudokuBoard *board_ptr, struct SudokuCell const cells[
  */
 void SetCellsOnColumn(struct SudokuBoard *board_ptr, struct SudokuCell const cells[kMaxNumber], int col) {
     for (int row = 0; row < kMaxNumber; ++row)
-        board_ptr->cells[row][col] = cells[row];
+        SetCellPossibles(board_ptr, row, col, cells[row].possibles);
 }
 
 
@@ -370,15 +597,64 @@ void SetCellsOnSquare(struct SudokuBoard *board_ptr, struct SudokuCell const cel
         row = base_row + (cell_index / kCellsPerSide);
         col = base_col + (cell_index % kCellsPerSide);
         
-        board_ptr->cells[row][col] = cells[cell_index];
+        SetCellPossibles(board_ptr, row, col, cells[cell_index].possibles);
     }
 }
 
 
+/**
+ Depth-first search for size entries of masks, taken in increasing index order
+ from start on, whose union has exactly size bits. The union is built up one
+ entry at a time and a branch is abandoned as soon as it exceeds size bits, so
+ most combinations are never looked at.
+
+ @param masks Array of bitfields.
+ @param num_masks Length of masks.
+ @param size Number of entries to choose.
+ @param start First index that may be chosen.
+ @param depth Number of entries chosen so far.
+ @param union_bits Union of the entries chosen so far.
+ @param chosen Receives the indices of the chosen entries (length size).
+ @return Union of the chosen entries if found; otherwise 0.
+ */
+static int FindSubset(int const masks[], int num_masks, int size, int start, int depth, int union_bits,
+                      int chosen[]) {
+    if (depth == size)
+        return BitCount(union_bits) == size ? union_bits : 0;
+    
+    for (int index = start; index <= num_masks - (size - depth); ++index) {
+        int bits = union_bits | masks[index];
+        if (BitCount(bits) > size)
+            continue;
+        
+        chosen[depth] = index;
+        int found = FindSubset(masks, num_masks, size, index + 1, depth + 1, bits, chosen);
+        if (found != 0)
+            return found;
+    }
+    
+    return 0;
+}
+
+
 /**
  Identify and return the clusters in the array of cells inputted. E.g., 
  if cell 0 and 1 can only have the values 3 and 5 each, then the cluster
  (3,5) is assigned to the cells [0, 1].
+ 
+ Clusters are found in order of increasing size. Once a cluster is found its
+ cells are set aside and its values are disregarded in the remaining cells
+ (FilterCellsByClusters() will remove them there anyway).
+ 
+ Among the m remaining cells, which between them hold m values, a cluster of
+ k cells always comes with a cluster of the other m - k cells holding the
+ other m - k values. Seen from the values, that second cluster is a hidden
+ subset: k values that fit in only k cells. Hence only sizes up to m / 2 are
+ searched, both as k cells sharing k values (naked) and as k values confined
+ to k cells (hidden); for a hidden subset the complementary cluster of size
+ m - k is reported, with the k hidden values in hidden_bits so that callers
+ explaining the step can name them. This finds clusters of any size while
+ never enumerating more than half of a unit.
 
  @param cells Array of kMaxNumber cells.
  @return struct LineClusterGroups specifying clusters of possible values on 
@@ -391,90 +667,143 @@ struct LineClusterGroups FindLineClusters(struct SudokuCell const cells[kMaxNumb
     int group_count = 0;
     bool is_in_cluster[kMaxNumber];
     SetBooleanArray(is_in_cluster, kMaxNumber, false);
-    int num_in_cluster = 0;
+    int claimed_bits = 0; // values of the clusters found so far
     
-    int bits_set;
-    int index;
-
-    for (int group_size = 1; group_size <= 3; ++group_size) {
-        // At this point we should group_size >= kMaxNumber - num_in_cluster.
-        // Otherwise there is no possible cluster of size group_size obviously.
-        // We could break here or the following code could/should execute trivially.
-        if (group_size >= kMaxNumber - num_in_cluster)
-            break;
-
-        // We use only the set of indices not yet assigned to a cluster. That will a limited set 0, ..., k
-        // called apparent indices. These will be mapped to the real index using an int array, apparent_to_real_index.
-        int num_apparent_indices = kMaxNumber - num_in_cluster;
-        int apparent_to_real_index[num_apparent_indices];
-        int real_index = 0;
-        int apparent_index = 0;
-        while (real_index < kMaxNumber) {
-            while (is_in_cluster[real_index]) {
-                ++real_index;
+    int remaining[kMaxNumber];      // indices of the cells not in a cluster
+    int masks[kMaxNumber];          // their possible values, less claimed_bits
+    int digit_bits[kMaxNumber];     // the values in remaining_bits, one bit each
+    int positions[kMaxNumber];      // per value: bit i set if possible in remaining[i]
+    int candidates[kMaxNumber];     // masks or positions small enough for the current size
+    int candidate_index[kMaxNumber];
+    int chosen[kMaxNumber];
+    int num_remaining = 0, num_digits = 0, remaining_bits = 0;
+    bool is_stale = true;           // remaining and remaining_bits need recomputing
+    bool positions_stale = true;    // digit_bits and positions need recomputing
+    int group_size = 1;
+    
+    // Clusters of one cell are by far the most common; take them all in one
+    // pass, as long as at least one other cell is left.
+    for (int index = 0; index < kMaxNumber && group_count < kMaxNumber - 1; ++index) {
+        int bits = cells[index].possibles & ~claimed_bits;
+        if (bits == 0 || (bits & (bits - 1)) != 0)
+            continue;
+        
+        struct LineCluster cluster;
+        cluster.size = 1;
+        cluster.positions = malloc(sizeof(int));
+        cluster.positions[0] = index;
+        cluster.bitset = bits;
+        cluster.hidden_bits = 0;
+        
+        is_in_cluster[index] = true;
+        claimed_bits |= bits;
+        groups.clusters[group_count++] = cluster;
+    }
+    
+    while (true) {
+        if (is_stale) {
+            num_remaining = 0;
+            remaining_bits = 0;
+            for (int index = 0; index < kMaxNumber; ++index) {
+                if (!is_in_cluster[index]) {
+                    remaining[num_remaining] = index;
+                    masks[num_remaining] = cells[index].possibles & ~claimed_bits;
+                    remaining_bits |= masks[num_remaining];
+                    ++num_remaining;
+                }
             }
-            
-            apparent_to_real_index[apparent_index++] = real_index++;
+            is_stale = false;
+            positions_stale = true;
         }
         
-        // keep track of the apparent indices for the group
-        int apparent_indices[group_size];
-        for (index = 0; index < group_size; ++index)
-            apparent_indices[index] = index;
-        int last_index = group_size - 1; // keeps track of the index we increment
+        // Larger clusters are the complements of smaller ones.
+        if (2 * group_size > num_remaining)
+            break;
+        
+        bool in_cluster[kMaxNumber];
+        SetBooleanArray(in_cluster, num_remaining, false);
+        int cluster_size = group_size;
+        int cluster_bits = 0;
+        int hidden_bits = 0;
         
-        while (true) {
-            bits_set = 0; // The total bits of the possible cluster (given the apparent indices)
-            for (index = 0; index < group_size; ++index) {
-                bits_set |= cells[apparent_to_real_index[apparent_indices[index]]].possibles;
+        // group_size cells sharing group_size values. A cell with more values cannot take part.
+        int num_candidates = 0;
+        for (int index = 0; index < num_remaining; ++index) {
+            if (BitCount(masks[index]) <= group_size) {
+                candidates[num_candidates] = masks[index];
+                candidate_index[num_candidates++] = index;
             }
-            if (BitCount(bits_set) == group_size) {
-                int *positions = malloc(group_size * sizeof(int)); // use calloc?
-                
-                for (index = 0; index < group_size; ++index) {
-                    int real_index = apparent_to_real_index[apparent_indices[index]];
-                    
-                    positions[index] = real_index;
-                    is_in_cluster[real_index] = true;
-                    ++num_in_cluster;
+        }
+        if (num_candidates >= group_size)
+            cluster_bits = FindSubset(candidates, num_candidates, group_size, 0, 0, 0, chosen);
+        
+        if (cluster_bits != 0) {
+            for (int index = 0; index < group_size; ++index)
+                in_cluster[candidate_index[chosen[index]]] = true;
+        }
+        else if (BitCount(remaining_bits) == num_remaining) {
+            // group_size values confined to group_size cells. With fewer
+            // values than cells the unit is contradictory and the complement
+            // argument does not hold.
+            if (positions_stale) {
+                num_digits = 0;
+                for (int bit = 1; bit <= remaining_bits; bit <<= 1) {
+                    if (remaining_bits & bit) {
+                        digit_bits[num_digits] = bit;
+                        positions[num_digits] = 0;
+                        for (int index = 0; index < num_remaining; ++index)
+                            if (masks[index] & bit)
+                                positions[num_digits] |= 1 << index;
+                        ++num_digits;
+                    }
                 }
-                
-                struct LineCluster cluster;
-                cluster.size = group_size;
-                cluster.positions = positions;
-                cluster.bitset = bits_set;
-                
-                groups.clusters[group_count++] = cluster;
+                positions_stale = false;
             }
             
-            // increment indices
-            while (last_index != -1) {
-                // the highest number of apparent_indices[last_index] should the highest number
-                // of an apparent index len(apparent_to_real_index)
-                // = kMaxNumber - num_in_cluster adjusted for the position
-                // since each subsequent apparent index must increase by (at least) 1.
-                // That is, we must subtract further (#apparent indices - 1) - last_index
-                // = group_size - 1 - last_index.
-                if (apparent_indices[last_index] < num_apparent_indices - 1 - (group_size - 1 - last_index)) {
-                    // increment the last_index position
-                    ++apparent_indices[last_index];
-                    // and set the remaining to follow that
-                    for (index = last_index + 1; index < group_size; ++index)
-                        apparent_indices[index] = apparent_indices[last_index] + (index - last_index);
-
-                    // next time we want to increment the end index
-                    last_index = group_size - 1;
-                    break;
-                }
-                else {
-                    --last_index;
+            num_candidates = 0;
+            for (int digit_index = 0; digit_index < num_digits; ++digit_index) {
+                if (BitCount(positions[digit_index]) <= group_size) {
+                    candidates[num_candidates] = positions[digit_index];
+                    candidate_index[num_candidates++] = digit_index;
                 }
             }
             
-            if (last_index == -1) {
-                break;
+            int hidden_positions = 0;
+            if (num_candidates >= group_size)
+                hidden_positions = FindSubset(candidates, num_candidates, group_size, 0, 0, 0, chosen);
+            
+            if (hidden_positions != 0) {
+                for (int index = 0; index < group_size; ++index)
+                    hidden_bits |= digit_bits[candidate_index[chosen[index]]];
+                cluster_bits = remaining_bits & ~hidden_bits;
+                for (int index = 0; index < num_remaining; ++index)
+                    in_cluster[index] = !(hidden_positions & (1 << index));
+                cluster_size = num_remaining - group_size;
             }
         }
+        
+        if (cluster_bits == 0) {
+            ++group_size;
+            continue;
+        }
+        
+        struct LineCluster cluster;
+        cluster.size = cluster_size;
+        cluster.positions = malloc(cluster_size * sizeof(int));
+        cluster.bitset = cluster_bits;
+        cluster.hidden_bits = hidden_bits;
+        
+        int position_count = 0;
+        for (int index = 0; index < num_remaining; ++index) {
+            if (in_cluster[index]) {
+                cluster.positions[position_count++] = remaining[index];
+                is_in_cluster[remaining[index]] = true;
+            }
+        }
+        claimed_bits |= cluster_bits;
+        is_stale = true;
+        
+        groups.clusters[group_count++] = cluster;
     }
     
     groups.size = group_count;
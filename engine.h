@@ -27,14 +27,27 @@ struct SudokuCell {
     unsigned int possibles : 9; // bitfield marking which numbers are still in the mix
 };
 
+struct TrailEntry {
+    short cell;                 // row * kMaxNumber + col
+    unsigned short possibles;   // value before the change
+};
+
+struct Trail {
+    struct TrailEntry *entries;
+    int size;
+    int capacity;
+};
+
 struct SudokuBoard {
     struct SudokuCell cells[9][9];
+    struct Trail *trail; // undo log of changes; NULL for none
 };
 
 struct LineCluster {
     int size;
     int bitset;
     int *positions;
+    int hidden_bits;    // found as a hidden subset: the values confined to the other open cells; else 0
 };
 
 struct LineClusterGroups {
@@ -58,9 +71,20 @@ struct ClusterGroups {
  */
 
 struct SudokuBoard * blank_board();
+void ClearBoard(struct SudokuBoard *board_ptr);
 int SinglePossible(struct SudokuCell cell);
 void SetCell(struct SudokuBoard *board_ptr, int row, int col, unsigned int value);
+void SetCellPossibles(struct SudokuBoard *board_ptr, int row, int col, unsigned int possibles);
+void InitTrail(struct Trail *trail);
+void FreeTrail(struct Trail *trail);
+int MarkCheckpoint(struct SudokuBoard const *board_ptr);
+void RestoreCheckpoint(struct SudokuBoard *board_ptr, int checkpoint);
 void PrintBoard(struct SudokuBoard *board_ptr);
+bool BoardFromString(struct SudokuBoard *board_ptr, char const *text);
+void BoardToString(struct SudokuBoard const *board_ptr, char *text);
+bool IsBoardSolved(struct SudokuBoard const *board_ptr);
+bool IsUnitContradictory(struct SudokuCell const cells[kMaxNumber]);
+bool IsBoardContradictory(struct SudokuBoard const *board_ptr);
 void SetBooleanArray(bool *array_ptr, int length, bool value);
 int RowAndColToSquare(int row, int col);
 struct SudokuCell *CellsFromSquare(struct SudokuBoard const *board_ptr, int square_num);
@@ -72,5 +96,9 @@ void SetCellsOnSquare(struct SudokuBoard *board_ptr, struct SudokuCell const cel
                       int square_num);
 int BitCount(int bits);
 void FilterCellsByClusters(struct SudokuCell cells[kMaxNumber], struct LineClusterGroups const *clusters);
+void FreeLineClusterGroups(struct LineClusterGroups *groups);
+void GetUnitCells(struct SudokuBoard const *board_ptr, int unit, struct SudokuCell cells[kMaxNumber]);
+void SetUnitCells(struct SudokuBoard *board_ptr, int unit, struct SudokuCell const cells[kMaxNumber]);
+void UnitCellPosition(int unit, int cell_index, int *row_ptr, int *col_ptr);
 
 #endif /* engine_h */
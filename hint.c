@@ -0,0 +1,278 @@
+//
+//  hint.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stdio.h>
+#include "engine.h"
+#include "hint.h"
+#include "trace.h"
+
+/*
+ Step-by-step hints for interactive clients.
+
+ The state keeps, per unit, whether the unit may still yield a deduction. A
+ unit that was examined and yielded nothing is only examined again once one
+ of its cells changes. Each call therefore costs the work for the units
+ touched by the previous hint rather than a pass over the whole board.
+
+ Singles are always preferred to clusters, so hints come in the order a
+ person would usually find them. FindLineClusters() reports a hidden subset as
+ the complementary cluster of the other open cells; a hint names the hidden
+ values and the cells they are confined to instead, which is how a person
+ would see the step.
+ */
+
+
+/**
+ Mark the three units of a cell as worth examining again.
+
+ @param state The hint state.
+ @param row Row of the changed cell.
+ @param col Column of the changed cell.
+ */
+static void MarkCellChanged(struct HintState *state, int row, int col) {
+    int units[3] = {row, kMaxNumber + col, 2 * kMaxNumber + RowAndColToSquare(row, col)};
+
+    for (int index = 0; index < 3; ++index) {
+        state->singles_pending[units[index]] = true;
+        state->clusters_pending[units[index]] = true;
+    }
+}
+
+
+/**
+ Start giving hints for a board. The board is copied into the state.
+
+ @param state The hint state to initialize.
+ @param board_ptr The board to give hints for.
+ */
+void InitHintState(struct HintState *state, struct SudokuBoard const *board_ptr) {
+    state->board = *board_ptr;
+    state->board.trail = NULL;
+
+    for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+        state->singles_pending[unit] = true;
+        state->clusters_pending[unit] = true;
+    }
+}
+
+
+/**
+ Fill in the eliminations of a cluster within its unit.
+
+ @param cells The kMaxNumber cells of the unit.
+ @param hint The hint, with unit and cluster already filled in. Receives the eliminations.
+ @return true if the cluster eliminates anything.
+ */
+static bool FindEliminations(struct SudokuCell const cells[kMaxNumber], struct Hint *hint) {
+    bool is_cluster_position[kMaxNumber];
+    SetBooleanArray(is_cluster_position, kMaxNumber, false);
+    for (int index = 0; index < hint->cluster_size; ++index)
+        is_cluster_position[hint->cluster_cells[index]] = true;
+
+    hint->num_eliminations = 0;
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles & hint->cluster_bits;
+        if (!is_cluster_position[cell_index] && bits != 0) {
+            hint->eliminated_cells[hint->num_eliminations] = cell_index;
+            hint->eliminated_bits[hint->num_eliminations] = bits;
+            ++hint->num_eliminations;
+        }
+    }
+
+    return hint->num_eliminations > 0;
+}
+
+
+/**
+ Fill in the eliminations of a hidden subset within its unit: the cells that
+ hold the hidden values lose every other value.
+
+ @param cells The kMaxNumber cells of the unit.
+ @param hint The hint, with unit and the hidden values in cluster_bits already
+    filled in. Receives the cells of the subset and the eliminations.
+ @return true if the subset eliminates anything.
+ */
+static bool FindHiddenEliminations(struct SudokuCell const cells[kMaxNumber], struct Hint *hint) {
+    hint->cluster_size = 0;
+    hint->num_eliminations = 0;
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles;
+        if ((bits & hint->cluster_bits) == 0)
+            continue;
+
+        hint->cluster_cells[hint->cluster_size++] = cell_index;
+        if ((bits & ~hint->cluster_bits) != 0) {
+            hint->eliminated_cells[hint->num_eliminations] = cell_index;
+            hint->eliminated_bits[hint->num_eliminations] = bits & ~hint->cluster_bits;
+            ++hint->num_eliminations;
+        }
+    }
+
+    return hint->num_eliminations > 0;
+}
+
+
+/**
+ Look for a solved cell whose value is still possible elsewhere in the unit.
+
+ @param cells The kMaxNumber cells of the unit.
+ @param hint Receives the deduction, with cells numbered within the unit.
+ @return true if one was found.
+ */
+static bool FindSingle(struct SudokuCell const cells[kMaxNumber], struct Hint *hint) {
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles;
+        if (bits == 0 || (bits & (bits - 1)) != 0)
+            continue;
+
+        hint->technique = kHintSingle;
+        hint->cluster_size = 1;
+        hint->cluster_bits = bits;
+        hint->cluster_cells[0] = cell_index;
+        if (FindEliminations(cells, hint))
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ Look for a cluster (as found by FindLineClusters()) that rules out values
+ elsewhere in the unit, or a hidden subset that rules out values in its cells.
+
+ @param cells The kMaxNumber cells of the unit.
+ @param hint Receives the deduction, with cells numbered within the unit.
+ @return true if one was found.
+ */
+static bool FindCluster(struct SudokuCell const cells[kMaxNumber], struct Hint *hint) {
+    struct LineClusterGroups clusters = FindLineClusters(cells);
+    bool found = false;
+
+    for (int cluster_num = 0; cluster_num < clusters.size && !found; ++cluster_num) {
+        struct LineCluster cluster = clusters.clusters[cluster_num];
+
+        if (cluster.hidden_bits != 0) {
+            hint->technique = kHintHidden;
+            hint->cluster_bits = cluster.hidden_bits;
+            found = FindHiddenEliminations(cells, hint);
+            continue;
+        }
+
+        hint->technique = cluster.size == 1 ? kHintSingle : kHintCluster;
+        hint->cluster_size = cluster.size;
+        hint->cluster_bits = cluster.bitset;
+        for (int index = 0; index < cluster.size; ++index)
+            hint->cluster_cells[index] = cluster.positions[index];
+        found = FindEliminations(cells, hint);
+    }
+
+    FreeLineClusterGroups(&clusters);
+    return found;
+}
+
+
+/**
+ Apply a hint found within a unit to the board and translate its cell
+ numbers from positions within the unit to board cells.
+
+ @param state The hint state. Its board will be modified.
+ @param hint The hint.
+ */
+static void ApplyHint(struct HintState *state, struct Hint *hint) {
+    int row, col;
+
+    SetTraceContext(hint->cluster_size == 1 ? kTraceSingles : kTraceClusters, hint->unit);
+    for (int index = 0; index < hint->cluster_size; ++index) {
+        UnitCellPosition(hint->unit, hint->cluster_cells[index], &row, &col);
+        hint->cluster_cells[index] = row * kMaxNumber + col;
+    }
+
+    for (int index = 0; index < hint->num_eliminations; ++index) {
+        UnitCellPosition(hint->unit, hint->eliminated_cells[index], &row, &col);
+        hint->eliminated_cells[index] = row * kMaxNumber + col;
+
+        SetCellPossibles(&state->board, row, col,
+                         state->board.cells[row][col].possibles & ~hint->eliminated_bits[index]);
+        MarkCellChanged(state, row, col);
+    }
+}
+
+
+/**
+ Find the next logical step on the board, apply it and describe it.
+
+ @param state The hint state. Its board is advanced by one deduction.
+ @param hint Receives the deduction.
+ @return false if no further deduction can be made (the board is solved or
+    needs techniques beyond clusters).
+ */
+bool NextHint(struct HintState *state, struct Hint *hint) {
+    struct SudokuCell cells[kMaxNumber];
+
+    for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+        if (!state->singles_pending[unit])
+            continue;
+
+        GetUnitCells(&state->board, unit, cells);
+        if (FindSingle(cells, hint)) {
+            hint->unit = unit;
+            ApplyHint(state, hint);
+            return true;
+        }
+        state->singles_pending[unit] = false;
+    }
+
+    for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+        if (!state->clusters_pending[unit])
+            continue;
+
+        GetUnitCells(&state->board, unit, cells);
+        if (FindCluster(cells, hint)) {
+            hint->unit = unit;
+            ApplyHint(state, hint);
+            return true;
+        }
+        state->clusters_pending[unit] = false;
+    }
+
+    return false;
+}
+
+
+/**
+ Print a one-line description of a hint.
+
+ @param hint The hint.
+ @param stream The stream to print to.
+ */
+void PrintHint(struct Hint const *hint, FILE *stream) {
+    static char const *technique_names[3] = {"Single", "Cluster", "Hidden"};
+    static char const *unit_names[3] = {"row", "column", "square"};
+
+    fprintf(stream, "%s in %s %d: values", technique_names[hint->technique],
+            unit_names[hint->unit / kMaxNumber], hint->unit % kMaxNumber + 1);
+    for (int digit = 1; digit <= kMaxNumber; ++digit)
+        if (hint->cluster_bits & (1 << (digit - 1)))
+            fprintf(stream, " %d", digit);
+
+    fprintf(stream, hint->technique == kHintHidden ? " only fit" : " at");
+    for (int index = 0; index < hint->cluster_size; ++index)
+        fprintf(stream, " r%dc%d", hint->cluster_cells[index] / kMaxNumber + 1,
+                hint->cluster_cells[index] % kMaxNumber + 1);
+
+    fprintf(stream, " rule out");
+    for (int index = 0; index < hint->num_eliminations; ++index) {
+        fprintf(stream, " r%dc%d:", hint->eliminated_cells[index] / kMaxNumber + 1,
+                hint->eliminated_cells[index] % kMaxNumber + 1);
+        for (int digit = 1; digit <= kMaxNumber; ++digit)
+            if (hint->eliminated_bits[index] & (1 << (digit - 1)))
+                fprintf(stream, "%d", digit);
+    }
+    fprintf(stream, "\n");
+}
@@ -0,0 +1,50 @@
+//
+//  hint.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef hint_h
+#define hint_h
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "engine.h"
+
+enum HintTechnique {
+    kHintSingle,   // a solved cell rules its value out for the rest of the unit
+    kHintCluster,  // n cells share n values, ruling them out for the rest of the unit
+    kHintHidden    // n values fit only n cells, ruling out every other value there
+};
+
+/**
+ A single deduction. Cells are numbered row * kMaxNumber + col.
+ */
+struct Hint {
+    enum HintTechnique technique;
+    int unit;                   // as in GetUnitCells()
+    int cluster_size;
+    int cluster_bits;           // the values of the cluster (for kHintHidden the hidden values)
+    int cluster_cells[9];       // the cells of the cluster (for kHintHidden the cells they fit)
+    int num_eliminations;       // cells that lose values
+    int eliminated_cells[9];
+    int eliminated_bits[9];     // the values each of those cells loses
+};
+
+/**
+ A board together with the bookkeeping that lets NextHint() look only at
+ units that changed since they were last examined.
+ */
+struct HintState {
+    struct SudokuBoard board;
+    bool singles_pending[27];   // unit may still yield a kHintSingle
+    bool clusters_pending[27];  // unit may still yield a kHintCluster
+};
+
+void InitHintState(struct HintState *state, struct SudokuBoard const *board_ptr);
+bool NextHint(struct HintState *state, struct Hint *hint);
+void PrintHint(struct Hint const *hint, FILE *stream);
+
+#endif /* hint_h */
@@ -0,0 +1,316 @@
+//
+//  layout.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stddef.h>
+#include "engine.h"
+#include "layout.h"
+#include "trace.h"
+
+/*
+ Puzzle variants as data.
+
+ A layout lists the units of a puzzle as tables of cell numbers: the classic
+ rows, columns and squares, jigsaw regions in place of the squares, or extra
+ units such as the diagonals. Every unit goes through the same
+ FindLineClusters()/FilterCellsByClusters() logic, so a variant costs what
+ its number of units costs and nothing more.
+
+ Killer cages are not units (they hold fewer than kMaxNumber values), so they
+ get their own rule: a value stays possible in a cage only if it belongs to a
+ value set of the right size and sum that can still be placed in the cage,
+ and a value solved in a cage is ruled out for the rest of it. The value sets
+ of each cage are listed once, when the cage is added.
+ */
+
+
+/**
+ Set up the classic layout: rows, columns and squares, numbered as in
+ GetUnitCells().
+
+ @param layout The layout to initialize.
+ */
+void InitClassicLayout(struct UnitLayout *layout) {
+    int row, col;
+
+    layout->num_units = 3 * kMaxNumber;
+    layout->num_cages = 0;
+    for (int unit = 0; unit < 3 * kMaxNumber; ++unit) {
+        for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+            UnitCellPosition(unit, cell_index, &row, &col);
+            layout->units[unit][cell_index] = (uint8_t) (row * kMaxNumber + col);
+        }
+    }
+}
+
+
+/**
+ Set up a jigsaw layout: rows, columns and irregular regions in place of the
+ squares.
+
+ @param layout The layout to initialize.
+ @param regions kMaxNumber * kMaxNumber characters '1' ... '9' giving the
+    region of each cell, row by row.
+ @return false if the regions are not kMaxNumber regions of kMaxNumber cells.
+ */
+bool InitJigsawLayout(struct UnitLayout *layout, char const *regions) {
+    int region_sizes[9] = {0};
+
+    InitClassicLayout(layout);
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int region = regions[cell] - '1';
+        if (region < 0 || region >= kMaxNumber || region_sizes[region] == kMaxNumber)
+            return false;
+        layout->units[2 * kMaxNumber + region][region_sizes[region]++] = (uint8_t) cell;
+    }
+
+    return true;
+}
+
+
+/**
+ Add the two main diagonals as units.
+
+ @param layout The layout to extend.
+ @return false if the layout has no room for them.
+ */
+bool AddDiagonalUnits(struct UnitLayout *layout) {
+    if (layout->num_units + 2 > kMaxUnits)
+        return false;
+
+    for (int index = 0; index < kMaxNumber; ++index) {
+        layout->units[layout->num_units][index] = (uint8_t) (index * kMaxNumber + index);
+        layout->units[layout->num_units + 1][index] = (uint8_t) (index * kMaxNumber + kMaxNumber - 1 - index);
+    }
+    layout->num_units += 2;
+
+    return true;
+}
+
+
+/**
+ Add a killer cage.
+
+ @param layout The layout to extend.
+ @param sum The sum of the values in the cage.
+ @param size Number of cells in the cage (1, ..., kMaxNumber).
+ @param cells The cells of the cage, numbered row * kMaxNumber + col.
+ @return false if the layout has no room for the cage, a cell is off the board
+    or listed twice, or no set of size distinct values adds up to sum.
+ */
+bool AddCage(struct UnitLayout *layout, int sum, int size, int const cells[]) {
+    if (layout->num_cages == kMaxCages || size < 1 || size > kMaxNumber)
+        return false;
+
+    for (int index = 0; index < size; ++index) {
+        if (cells[index] < 0 || cells[index] >= kMaxNumber * kMaxNumber)
+            return false;
+        for (int other = 0; other < index; ++other)
+            if (cells[other] == cells[index])
+                return false;
+    }
+
+    struct Cage *cage = &layout->cages[layout->num_cages];
+    cage->size = (uint8_t) size;
+    cage->sum = (uint8_t) sum;
+    cage->num_combos = 0;
+    for (int index = 0; index < size; ++index)
+        cage->cells[index] = (uint8_t) cells[index];
+
+    for (int bits = 1; bits <= kAllBits; ++bits) {
+        if (BitCount(bits) != size)
+            continue;
+
+        int bits_sum = 0;
+        for (int digit = 1; digit <= kMaxNumber; ++digit)
+            if (bits & (1 << (digit - 1)))
+                bits_sum += digit;
+        if (bits_sum == sum)
+            cage->combos[cage->num_combos++] = (uint16_t) bits;
+    }
+
+    if (cage->num_combos == 0)
+        return false;
+
+    ++layout->num_cages;
+    return true;
+}
+
+
+/**
+ Apply the cluster logic to one unit.
+
+ @param board_ptr The board. Will be modified.
+ @param unit_cells The cells of the unit.
+ @return true if any cell changed.
+ */
+static bool FilterUnit(struct SudokuBoard *board_ptr, uint8_t const unit_cells[9]) {
+    struct SudokuCell cells[kMaxNumber];
+    bool changed = false;
+
+    for (int index = 0; index < kMaxNumber; ++index)
+        cells[index] = board_ptr->cells[unit_cells[index] / kMaxNumber][unit_cells[index] % kMaxNumber];
+
+    struct LineClusterGroups clusters = FindLineClusters(cells);
+    FilterCellsByClusters(cells, &clusters);
+    FreeLineClusterGroups(&clusters);
+
+    for (int index = 0; index < kMaxNumber; ++index) {
+        int row = unit_cells[index] / kMaxNumber;
+        int col = unit_cells[index] % kMaxNumber;
+        if (cells[index].possibles != board_ptr->cells[row][col].possibles) {
+            SetCellPossibles(board_ptr, row, col, cells[index].possibles);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+/**
+ Restrict the cells of a cage to the value sets that can still be placed in
+ it, and rule values solved in the cage out for the rest of it.
+
+ @param board_ptr The board. Will be modified.
+ @param cage The cage.
+ @return true if any cell changed.
+ */
+static bool FilterCage(struct SudokuBoard *board_ptr, struct Cage const *cage) {
+    int possibles[9];
+    int all_bits = 0;
+    int solved_bits = 0;
+    int allowed = 0;
+    bool changed = false;
+
+    for (int index = 0; index < cage->size; ++index) {
+        int bits = board_ptr->cells[cage->cells[index] / kMaxNumber][cage->cells[index] % kMaxNumber].possibles;
+        possibles[index] = bits;
+        all_bits |= bits;
+        if (bits != 0 && (bits & (bits - 1)) == 0)
+            solved_bits |= bits;
+    }
+
+    for (int combo_num = 0; combo_num < cage->num_combos; ++combo_num) {
+        int combo = cage->combos[combo_num];
+        bool fits = (combo & ~all_bits) == 0 && (combo & solved_bits) == solved_bits;
+
+        for (int index = 0; index < cage->size && fits; ++index)
+            fits = (possibles[index] & combo) != 0;
+        if (fits)
+            allowed |= combo;
+    }
+
+    for (int index = 0; index < cage->size; ++index) {
+        int bits = possibles[index] & allowed;
+        if (BitCount(possibles[index]) > 1)
+            bits &= ~solved_bits;
+
+        if (bits != possibles[index]) {
+            SetCellPossibles(board_ptr, cage->cells[index] / kMaxNumber, cage->cells[index] % kMaxNumber,
+                             (unsigned int) bits);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+/**
+ Return whether units 18 ... 26 of a layout are the classic squares.
+
+ @param layout The layout.
+ @return false for a jigsaw layout.
+ */
+static bool HasSquares(struct UnitLayout const *layout) {
+    int row, col;
+
+    for (int unit = 2 * kMaxNumber; unit < 3 * kMaxNumber; ++unit) {
+        for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+            UnitCellPosition(unit, cell_index, &row, &col);
+            if (layout->units[unit][cell_index] != row * kMaxNumber + col)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ Reduce possibilities in each cell as much as the cluster logic on every unit
+ of the layout and the cage rule allow, as SolveBoard() does for classic
+ puzzles.
+
+ @param board_ptr Pointer to the board. Will be modified.
+ @param layout The units and cages of the puzzle.
+ */
+void SolveBoardWithLayout(struct SudokuBoard *board_ptr, struct UnitLayout const *layout) {
+    bool changed;
+
+    if (current_trace_ring != NULL)
+        SetTraceRegions(!HasSquares(layout));
+    do {
+        changed = false;
+        for (int unit = 0; unit < layout->num_units; ++unit) {
+            SetTraceContext(kTraceClusters, unit);
+            changed |= FilterUnit(board_ptr, layout->units[unit]);
+        }
+        for (int cage_num = 0; cage_num < layout->num_cages; ++cage_num) {
+            SetTraceContext(kTraceCage, cage_num);
+            changed |= FilterCage(board_ptr, &layout->cages[cage_num]);
+        }
+    } while (changed);
+    SetTraceRegions(false);
+}
+
+
+/**
+ Return whether the board can no longer be completed under the layout, as
+ IsBoardContradictory() does for classic puzzles. A cage is also
+ contradictory once it is filled with a wrong sum or a repeated value.
+
+ @param board_ptr Pointer to the board.
+ @param layout The units and cages of the puzzle.
+ @return true if the board has no solution.
+ */
+bool IsLayoutContradictory(struct SudokuBoard const *board_ptr, struct UnitLayout const *layout) {
+    struct SudokuCell cells[kMaxNumber];
+
+    for (int unit = 0; unit < layout->num_units; ++unit) {
+        for (int index = 0; index < kMaxNumber; ++index) {
+            int cell = layout->units[unit][index];
+            cells[index] = board_ptr->cells[cell / kMaxNumber][cell % kMaxNumber];
+        }
+        if (IsUnitContradictory(cells))
+            return true;
+    }
+
+    for (int cage_num = 0; cage_num < layout->num_cages; ++cage_num) {
+        struct Cage const *cage = &layout->cages[cage_num];
+        int solved_bits = 0;
+        int sum = 0;
+        int num_solved = 0;
+
+        for (int index = 0; index < cage->size; ++index) {
+            int value = SinglePossible(board_ptr->cells[cage->cells[index] / kMaxNumber][cage->cells[index] % kMaxNumber]);
+            if (value == -1)
+                continue;
+            if (solved_bits & (1 << (value - 1)))
+                return true;
+            solved_bits |= 1 << (value - 1);
+            sum += value;
+            ++num_solved;
+        }
+
+        if (sum > cage->sum || (num_solved == cage->size && sum != cage->sum))
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,49 @@
+//
+//  layout.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef layout_h
+#define layout_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+
+#define kMaxUnits 29       // rows, columns, squares or regions, and two diagonals
+#define kMaxCages 81
+#define kMaxCageCombos 12  // most sets of distinct values with the same size and sum
+
+/**
+ A killer cage: its cells hold distinct values that add up to sum.
+ */
+struct Cage {
+    uint8_t size;
+    uint8_t sum;
+    uint8_t cells[9];                  // row * kMaxNumber + col
+    uint8_t num_combos;
+    uint16_t combos[kMaxCageCombos];   // bitsets of the value sets that fit size and sum
+};
+
+/**
+ The constraints of a puzzle as index tables. Each unit is kMaxNumber cells
+ that hold every value once; cages are optional extra constraints.
+ */
+struct UnitLayout {
+    int num_units;
+    uint8_t units[kMaxUnits][9];       // row * kMaxNumber + col
+    int num_cages;
+    struct Cage cages[kMaxCages];
+};
+
+void InitClassicLayout(struct UnitLayout *layout);
+bool InitJigsawLayout(struct UnitLayout *layout, char const *regions);
+bool AddDiagonalUnits(struct UnitLayout *layout);
+bool AddCage(struct UnitLayout *layout, int sum, int size, int const cells[]);
+void SolveBoardWithLayout(struct SudokuBoard *board_ptr, struct UnitLayout const *layout);
+bool IsLayoutContradictory(struct SudokuBoard const *board_ptr, struct UnitLayout const *layout);
+
+#endif /* layout_h */
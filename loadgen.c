@@ -0,0 +1,621 @@
+//
+//  loadgen.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L   // clock_nanosleep(), strdup()
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "dispatch.h"
+#include "engine.h"
+#include "loadgen.h"
+#include "scheduler.h"
+
+/*
+ Load generation for measuring the solver under concurrency.
+
+ Each thread solves puzzles with SolveBoardTiered() on a schedule. With a
+ rate, the schedule is open-loop: puzzle i of a thread is due at a fixed time,
+ whether or not the previous one has been answered, and its latency is counted
+ from when it was due. A solver that stalls therefore shows up in the latency
+ of every puzzle that queued behind the stall, as it would for clients arriving
+ at that rate, rather than being hidden by the load generator waiting for it
+ (coordinated omission). Puzzles that were due but never started by the end of
+ the run are recorded too, with the time they had waited until then, which is
+ less than they would have waited for an answer. The service time, from start
+ to answer, is recorded as well; the gap between the two is the queueing. Without a rate each thread
+ starts the next puzzle as soon as it has answered the previous one, which
+ measures throughput, and both times are the same.
+
+ Puzzles are prepared before the clock starts, so generating them does not
+ count. Generated puzzles are random relabellings and row/column shuffles of a
+ known solution with cells blanked, or of puzzles known to need search, and
+ each is made for one tier of SolveBoardTiered(). A blanked grid is kept only
+ once that tier is the one that finishes it, which also makes it unique:
+ easy puzzles are retried until naked singles solve them, and mid puzzles
+ have cells blanked one at a time, putting back any that would need search,
+ until singles stall but the cluster logic still solves them.
+
+ Histograms are log-linear: exact below 2^kHistogramSubBits ns and with
+ 2^kHistogramSubBits buckets per power of two above, so recording is a few
+ instructions and every percentile is within about 3%. Each thread keeps its
+ own and they are added up at the end.
+ */
+
+static const char kLoadSolution[] =
+    "195674832624398175837521496963147528571283964482956317248739651356812749719465283";
+
+static char const *kHardPuzzles[] = {
+    "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4..",
+    "..53.....8......2..7..1.5..4....53...1..7...6..32...8..6.5....9..4....3......97..",
+    "12.3....435....1....4........54..2..6...7.........8.9...31..5.......9.7.....6...8",
+};
+
+static const int kNumHardPuzzles = sizeof kHardPuzzles / sizeof kHardPuzzles[0];
+static const int kLoadPoolSize = 4096;     // generated puzzles shared by the threads
+static const int kMinBlanks = 20;          // cells blanked in an easy puzzle
+static const int kMaxBlanks = 30;
+static const int kMaxGenerateAttempts = 100;
+
+struct LoadShared {
+    struct LoadOptions options;
+    struct SudokuBoard *pool;
+    int pool_size;
+    int64_t start;
+    int64_t end;
+};
+
+struct LoadWorker {
+    struct LoadShared const *shared;
+    int id;
+    long completed;
+    long behind;
+    struct LatencyHistogram latency;
+    struct LatencyHistogram service;
+    struct DispatchStats dispatch;
+};
+
+
+/**
+ Return the current value of a monotonic clock in nanoseconds.
+
+ @return Nanoseconds since an arbitrary point in time.
+ */
+static int64_t NowNanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/**
+ Sleep until the monotonic clock reaches a time.
+
+ @param nanoseconds The time, as returned by NowNanoseconds().
+ */
+static void SleepUntil(int64_t nanoseconds) {
+    struct timespec until = {(time_t) (nanoseconds / 1000000000), (long) (nanoseconds % 1000000000)};
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+        ;
+}
+
+
+/**
+ Return the next number of an xorshift64* generator.
+
+ @param state The generator state, not 0. Updated.
+ @return A pseudo-random 64-bit number.
+ */
+static uint64_t NextRandom(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+
+/**
+ Shuffle an array of numbers.
+
+ @param values The numbers. Will be reordered.
+ @param count How many there are.
+ @param state The generator state. Updated.
+ */
+static void Shuffle(int values[], int count, uint64_t *state) {
+    for (int index = count - 1; index > 0; --index) {
+        int other = (int) (NextRandom(state) % (uint64_t) (index + 1));
+        int value = values[index];
+        values[index] = values[other];
+        values[other] = value;
+    }
+}
+
+
+/**
+ Fill an order of the rows (or columns) of a board that keeps each band (or
+ stack) together: the bands in random order, each with its rows in random
+ order.
+
+ @param order Receives kMaxNumber row numbers.
+ @param state The generator state. Updated.
+ */
+static void RandomLineOrder(int order[], uint64_t *state) {
+    int bands[kCellsPerSide], lines[kCellsPerSide];
+
+    for (int index = 0; index < kCellsPerSide; ++index)
+        bands[index] = index;
+    Shuffle(bands, kCellsPerSide, state);
+
+    for (int band = 0; band < kCellsPerSide; ++band) {
+        for (int index = 0; index < kCellsPerSide; ++index)
+            lines[index] = index;
+        Shuffle(lines, kCellsPerSide, state);
+        for (int index = 0; index < kCellsPerSide; ++index)
+            order[band * kCellsPerSide + index] = bands[band] * kCellsPerSide + lines[index];
+    }
+}
+
+
+/**
+ Return the tier of SolveBoardTiered() that finishes a puzzle.
+
+ @param puzzle kMaxNumber * kMaxNumber characters in the format of BoardFromString().
+ @param scheduler The scheduler for the cluster tier.
+ @return The tier, or kNumDispatchTiers if the puzzle has no solution or more than one.
+ */
+static enum DispatchTier PuzzleTier(char const puzzle[81], struct SolveScheduler *scheduler) {
+    struct SudokuBoard board;
+    struct DispatchStats stats;
+
+    InitDispatchStats(&stats);
+    BoardFromString(&board, puzzle);
+    if (!SolveBoardTiered(&board, scheduler, &stats))
+        return kNumDispatchTiers;
+    for (int tier = 0; tier < kNumDispatchTiers; ++tier)
+        if (stats.solved[tier] != 0)
+            return (enum DispatchTier) tier;
+    return kNumDispatchTiers;
+}
+
+
+/**
+ Blank cells of a full grid one at a time in random order, putting back each
+ one that would leave the puzzle to search, until the cluster logic is needed.
+
+ @param rng_state The generator state. Updated.
+ @param puzzle A full grid. Receives the puzzle.
+ @param scheduler The scheduler for the cluster tier.
+ @return false if every cell was tried before singles stalled.
+ */
+static bool BlankForClusters(uint64_t *rng_state, char puzzle[81], struct SolveScheduler *scheduler) {
+    int order[kMaxNumber * kMaxNumber];
+
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell)
+        order[cell] = cell;
+    Shuffle(order, kMaxNumber * kMaxNumber, rng_state);
+
+    for (int index = 0; index < kMaxNumber * kMaxNumber; ++index) {
+        char symbol = puzzle[order[index]];
+        puzzle[order[index]] = '.';
+        enum DispatchTier tier = PuzzleTier(puzzle, scheduler);
+        if (tier == kTierClusters)
+            return true;
+        if (tier != kTierSingles)
+            puzzle[order[index]] = symbol;
+    }
+    return false;
+}
+
+
+/**
+ Write a random puzzle for one tier: a transformation of a known solution with
+ cells blanked, or of a puzzle known to need search. The transformations
+ (relabelling the values, shuffling bands, stacks, and rows and columns within
+ them, transposing) keep every puzzle valid and as hard as the one it came from.
+
+ @param rng_state The generator state, not 0. Updated.
+ @param tier The tier of SolveBoardTiered() that should finish the puzzle.
+ @param puzzle Receives kMaxNumber * kMaxNumber characters in the format of BoardFromString().
+ */
+void GenerateLoadPuzzle(uint64_t *rng_state, enum DispatchTier tier, char puzzle[81]) {
+    int rows[kMaxNumber], cols[kMaxNumber], values[kMaxNumber + 1];
+    bool hard = tier == kTierSearch;
+    char const *source = hard ? kHardPuzzles[NextRandom(rng_state) % (uint64_t) kNumHardPuzzles] : kLoadSolution;
+    bool transpose = NextRandom(rng_state) & 1;
+
+    RandomLineOrder(rows, rng_state);
+    RandomLineOrder(cols, rng_state);
+    for (int value = 0; value <= kMaxNumber; ++value)
+        values[value] = value;
+    Shuffle(values + 1, kMaxNumber, rng_state);
+
+    for (int row = 0; row < kMaxNumber; ++row) {
+        for (int col = 0; col < kMaxNumber; ++col) {
+            int from_row = transpose ? cols[col] : rows[row];
+            int from_col = transpose ? rows[row] : cols[col];
+            char symbol = source[from_row * kMaxNumber + from_col];
+            puzzle[row * kMaxNumber + col] = symbol == '.' ? '.' : (char) ('0' + values[symbol - '0']);
+        }
+    }
+
+    if (hard)
+        return;
+
+    // Random blanks almost always leave an easy puzzle to singles, and the
+    // greedy blanking almost always reaches the cluster tier, so the attempts
+    // only guard against a pathological generator state.
+    struct SolveScheduler scheduler;
+    char grid[kMaxNumber * kMaxNumber];
+    InitSolveScheduler(&scheduler);
+    memcpy(grid, puzzle, sizeof grid);
+    for (int attempt = 0; attempt < kMaxGenerateAttempts; ++attempt) {
+        memcpy(puzzle, grid, sizeof grid);
+        if (tier == kTierClusters) {
+            if (BlankForClusters(rng_state, puzzle, &scheduler))
+                return;
+            continue;
+        }
+        int blanks = kMinBlanks + (int) (NextRandom(rng_state) % (uint64_t) (kMaxBlanks - kMinBlanks + 1));
+        for (int blank = 0; blank < blanks; ++blank)
+            puzzle[NextRandom(rng_state) % (uint64_t) (kMaxNumber * kMaxNumber)] = '.';
+        if (PuzzleTier(puzzle, &scheduler) == kTierSingles)
+            return;
+    }
+    memcpy(puzzle, grid, sizeof grid);
+}
+
+
+/**
+ Reset a histogram.
+
+ @param histogram The histogram to initialize.
+ */
+void InitLatencyHistogram(struct LatencyHistogram *histogram) {
+    memset(histogram->counts, 0, sizeof histogram->counts);
+    histogram->total = 0;
+    histogram->max = 0;
+}
+
+
+/**
+ Return the bucket of a value.
+
+ @param nanoseconds The value, not negative.
+ @return The bucket index.
+ */
+static int HistogramBucket(int64_t nanoseconds) {
+    uint64_t value = (uint64_t) nanoseconds;
+
+    if (value < (1 << kHistogramSubBits))
+        return (int) value;
+
+#if defined(__GNUC__) || defined(__clang__)
+    int exponent = 63 - __builtin_clzll(value);
+#else
+    int exponent = 0;
+    while (value >> (exponent + 1))
+        ++exponent;
+#endif
+    int bucket = (exponent - kHistogramSubBits + 1) * (1 << kHistogramSubBits) +
+        (int) ((value >> (exponent - kHistogramSubBits)) & ((1 << kHistogramSubBits) - 1));
+    return bucket < kHistogramBuckets ? bucket : kHistogramBuckets - 1;
+}
+
+
+/**
+ Return the highest value counted in a bucket.
+
+ @param bucket The bucket index.
+ @return The value.
+ */
+static int64_t BucketHighestValue(int bucket) {
+    if (bucket < (1 << kHistogramSubBits))
+        return bucket;
+
+    int exponent = bucket / (1 << kHistogramSubBits) + kHistogramSubBits - 1;
+    int64_t lowest = (int64_t) ((1 << kHistogramSubBits) + bucket % (1 << kHistogramSubBits))
+        << (exponent - kHistogramSubBits);
+    return lowest + ((int64_t) 1 << (exponent - kHistogramSubBits)) - 1;
+}
+
+
+/**
+ Count one latency.
+
+ @param histogram The histogram.
+ @param nanoseconds The latency. Negative values count as 0.
+ */
+void RecordLatency(struct LatencyHistogram *histogram, int64_t nanoseconds) {
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+
+    ++histogram->counts[HistogramBucket(nanoseconds)];
+    ++histogram->total;
+    if (nanoseconds > histogram->max)
+        histogram->max = nanoseconds;
+}
+
+
+/**
+ Add the counts of one histogram to another.
+
+ @param total The histogram to add to.
+ @param part The histogram to add.
+ */
+void AddLatencyHistogram(struct LatencyHistogram *total, struct LatencyHistogram const *part) {
+    for (int bucket = 0; bucket < kHistogramBuckets; ++bucket)
+        total->counts[bucket] += part->counts[bucket];
+    total->total += part->total;
+    if (part->max > total->max)
+        total->max = part->max;
+}
+
+
+/**
+ Return the latency below or at which a given share of the counted latencies
+ lie, rounded up to the end of its bucket. Latencies beyond the last bucket
+ are reported as the maximum.
+
+ @param histogram The histogram.
+ @param percentile The share in percent (0, ..., 100).
+ @return The latency in nanoseconds; 0 if nothing was counted.
+ */
+int64_t LatencyPercentile(struct LatencyHistogram const *histogram, double percentile) {
+    double exact_rank = percentile / 100.0 * histogram->total;
+    long rank = (long) exact_rank;
+    long seen = 0;
+
+    if (rank < exact_rank)
+        ++rank;
+    if (rank < 1)
+        rank = 1;
+    for (int bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank && bucket < kHistogramBuckets - 1) {
+            int64_t value = BucketHighestValue(bucket);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+
+/**
+ Read puzzles, one per line, keeping the lines that are puzzles.
+
+ @param input The input stream.
+ @param lines Receives an array of null-terminated puzzles; free with FreeLoadCorpus().
+ @return The number of puzzles.
+ */
+int ReadLoadCorpus(FILE *input, char ***lines) {
+    char line[128];
+    struct SudokuBoard board;
+    int size = 0, capacity = 0;
+
+    *lines = NULL;
+    while (fgets(line, sizeof line, input) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strlen(line) != (size_t) (kMaxNumber * kMaxNumber) || !BoardFromString(&board, line))
+            continue;
+
+        if (size == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : 256;
+            *lines = realloc(*lines, capacity * sizeof(char *));
+        }
+        (*lines)[size++] = strdup(line);
+    }
+
+    return size;
+}
+
+
+/**
+ Free the puzzles read by ReadLoadCorpus().
+
+ @param lines The puzzles.
+ @param size The number of puzzles.
+ */
+void FreeLoadCorpus(char **lines, int size) {
+    for (int index = 0; index < size; ++index)
+        free(lines[index]);
+    free(lines);
+}
+
+
+/**
+ Return the default load: one thread per online processor, as fast as they
+ go for ten seconds, with one generated puzzle in twenty needing search.
+
+ @return struct LoadOptions.
+ */
+struct LoadOptions DefaultLoadOptions() {
+    struct LoadOptions options;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    options.num_threads = num_cpus > 0 ? (int) num_cpus : 1;
+    options.rate = 0.0;
+    options.seconds = 10.0;
+    options.hard_fraction = 0.05;
+    options.cluster_fraction = 0.15;
+    options.corpus = NULL;
+    options.corpus_size = 0;
+    options.seed = 1;
+
+    return options;
+}
+
+
+/**
+ Solve one puzzle from the pool and record its times.
+
+ @param worker The worker.
+ @param index Position of the puzzle in the worker's sequence.
+ @param due When the puzzle was due.
+ @param scheduler The worker's scheduler.
+ */
+static void SolveLoadPuzzle(struct LoadWorker *worker, long index, int64_t due, struct SolveScheduler *scheduler) {
+    struct LoadShared const *shared = worker->shared;
+    // Threads start at different places in the pool so they do not solve in lockstep.
+    struct SudokuBoard board = shared->pool[(worker->id * 997 + index) % shared->pool_size];
+
+    int64_t started = NowNanoseconds();
+    SolveBoardTiered(&board, scheduler, &worker->dispatch);
+    int64_t done = NowNanoseconds();
+
+    RecordLatency(&worker->latency, done - due);
+    RecordLatency(&worker->service, done - started);
+    ++worker->completed;
+}
+
+
+/**
+ Load thread: solve puzzles on schedule until the end of the run.
+
+ @param arg Pointer to struct LoadWorker.
+ @return NULL.
+ */
+static void *LoadWorkerMain(void *arg) {
+    struct LoadWorker *worker = arg;
+    struct LoadShared const *shared = worker->shared;
+    struct SolveScheduler scheduler;
+
+    InitSolveScheduler(&scheduler);
+
+    if (shared->options.rate <= 0.0) {
+        for (long index = 0; NowNanoseconds() < shared->end; ++index)
+            SolveLoadPuzzle(worker, index, NowNanoseconds(), &scheduler);
+        return NULL;
+    }
+
+    // Each thread takes every num_threads-th arrival of the overall schedule.
+    double interval = 1e9 * shared->options.num_threads / shared->options.rate;
+    double first = shared->start + 1e9 * worker->id / shared->options.rate;
+    for (long index = 0; ; ++index) {
+        int64_t due = (int64_t) (first + index * interval);
+        if (due >= shared->end)
+            break;
+
+        int64_t now = NowNanoseconds();
+        if (now >= shared->end) {
+            // The rest of the schedule never started; count it rather than drop it silently.
+            for (; due < shared->end; due = (int64_t) (first + ++index * interval)) {
+                RecordLatency(&worker->latency, now - due);
+                ++worker->behind;
+            }
+            break;
+        }
+        if (now < due)
+            SleepUntil(due);
+
+        SolveLoadPuzzle(worker, index, due, &scheduler);
+    }
+
+    return NULL;
+}
+
+
+/**
+ Drive the solver with the configured load and measure it.
+
+ @param options Threads, rate, length, puzzle mix and source.
+ @param result Receives the measurements.
+ @return Non-zero if the threads could not be started or the corpus holds no puzzle.
+ */
+int RunLoad(struct LoadOptions const *options, struct LoadResult *result) {
+    struct LoadShared shared;
+    int num_threads = options->num_threads > 1 ? options->num_threads : 1;
+    uint64_t rng_state = options->seed != 0 ? options->seed : 1;
+    char puzzle[kMaxNumber * kMaxNumber];
+
+    shared.options = *options;
+    shared.options.num_threads = num_threads;
+    shared.pool_size = options->corpus != NULL ? options->corpus_size : kLoadPoolSize;
+    if (shared.pool_size <= 0)
+        return 1;
+
+    shared.pool = malloc(shared.pool_size * sizeof(struct SudokuBoard));
+    for (int index = 0; index < shared.pool_size; ++index) {
+        if (options->corpus != NULL) {
+            BoardFromString(&shared.pool[index], options->corpus[index]);
+        }
+        else {
+            double draw = (double) (NextRandom(&rng_state) >> 11) / (double) (1ULL << 53);
+            enum DispatchTier tier = draw < options->hard_fraction ? kTierSearch
+                : draw < options->hard_fraction + options->cluster_fraction ? kTierClusters : kTierSingles;
+            GenerateLoadPuzzle(&rng_state, tier, puzzle);
+            BoardFromString(&shared.pool[index], puzzle);
+        }
+    }
+
+    struct LoadWorker *workers = malloc(num_threads * sizeof(struct LoadWorker));
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    for (int id = 0; id < num_threads; ++id) {
+        workers[id].shared = &shared;
+        workers[id].id = id;
+        workers[id].completed = 0;
+        workers[id].behind = 0;
+        InitLatencyHistogram(&workers[id].latency);
+        InitLatencyHistogram(&workers[id].service);
+        InitDispatchStats(&workers[id].dispatch);
+    }
+
+    shared.start = NowNanoseconds();
+    shared.end = shared.start + (int64_t) (options->seconds * 1e9);
+    int started = 0;
+    while (started < num_threads && pthread_create(&threads[started], NULL, LoadWorkerMain, &workers[started]) == 0)
+        ++started;
+    for (int id = 0; id < started; ++id)
+        pthread_join(threads[id], NULL);
+    result->seconds = (NowNanoseconds() - shared.start) / 1e9;
+
+    result->completed = 0;
+    result->behind = 0;
+    InitLatencyHistogram(&result->latency);
+    InitLatencyHistogram(&result->service);
+    InitDispatchStats(&result->dispatch);
+    for (int id = 0; id < started; ++id) {
+        result->completed += workers[id].completed;
+        result->behind += workers[id].behind;
+        AddLatencyHistogram(&result->latency, &workers[id].latency);
+        AddLatencyHistogram(&result->service, &workers[id].service);
+        AddDispatchStats(&result->dispatch, &workers[id].dispatch);
+    }
+
+    free(threads);
+    free(workers);
+    free(shared.pool);
+
+    return started == num_threads ? 0 : 1;
+}
+
+
+/**
+ Print throughput, latency and service time percentiles, and the tiers that
+ solved the puzzles.
+
+ @param result The measurements.
+ @param stream The stream to print to.
+ */
+void PrintLoadResult(struct LoadResult const *result, FILE *stream) {
+    struct LatencyHistogram const *histograms[2] = {&result->latency, &result->service};
+    static char const *names[2] = {"latency", "service"};
+
+    fprintf(stream, "%ld puzzles in %.2f s: %.0f puzzles/s, %ld behind schedule\n", result->completed,
+            result->seconds, result->seconds > 0 ? result->completed / result->seconds : 0.0, result->behind);
+    fprintf(stream, "%-8s %12s %12s %12s %12s\n", "us", "p50", "p99", "p99.9", "max");
+    for (int index = 0; index < 2; ++index)
+        fprintf(stream, "%-8s %12.1f %12.1f %12.1f %12.1f\n", names[index],
+                LatencyPercentile(histograms[index], 50.0) / 1e3, LatencyPercentile(histograms[index], 99.0) / 1e3,
+                LatencyPercentile(histograms[index], 99.9) / 1e3, histograms[index]->max / 1e3);
+    PrintDispatchStats(&result->dispatch, stream);
+}
@@ -0,0 +1,61 @@
+//
+//  loadgen.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef loadgen_h
+#define loadgen_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "dispatch.h"
+
+#define kHistogramSubBits 5        // 32 buckets per power of two: values within about 3%
+#define kHistogramBuckets (41 * (1 << kHistogramSubBits)) // up to 2^45 ns, about 10 hours
+
+/**
+ Latencies in nanoseconds, counted in log-linear buckets.
+ */
+struct LatencyHistogram {
+    long counts[kHistogramBuckets];
+    long total;
+    int64_t max;
+};
+
+struct LoadOptions {
+    int num_threads;           // concurrent solvers
+    double rate;               // puzzles per second over all threads; 0 for as fast as they go
+    double seconds;            // length of the run
+    double hard_fraction;      // share of generated puzzles that need search
+    double cluster_fraction;   // share that need the cluster logic but not search; the rest fall to singles
+    char const *const *corpus; // puzzles in the format of BoardFromString() used instead of generated ones; NULL for none
+    int corpus_size;
+    uint64_t seed;             // for the puzzle generator
+};
+
+struct LoadResult {
+    long completed;            // puzzles solved
+    long behind;               // puzzles due before the end of the run but never started
+    double seconds;            // wall time of the run
+    struct LatencyHistogram latency;  // from the time each puzzle was due to its answer, or for those
+                                      // behind to the end of the run
+    struct LatencyHistogram service;  // from the time each puzzle was started to its answer
+    struct DispatchStats dispatch;
+};
+
+void InitLatencyHistogram(struct LatencyHistogram *histogram);
+void RecordLatency(struct LatencyHistogram *histogram, int64_t nanoseconds);
+void AddLatencyHistogram(struct LatencyHistogram *total, struct LatencyHistogram const *part);
+int64_t LatencyPercentile(struct LatencyHistogram const *histogram, double percentile);
+void GenerateLoadPuzzle(uint64_t *rng_state, enum DispatchTier tier, char puzzle[81]);
+int ReadLoadCorpus(FILE *input, char ***lines);
+void FreeLoadCorpus(char **lines, int size);
+struct LoadOptions DefaultLoadOptions();
+int RunLoad(struct LoadOptions const *options, struct LoadResult *result);
+void PrintLoadResult(struct LoadResult const *result, FILE *stream);
+
+#endif /* loadgen_h */
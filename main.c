@@ -7,18 +7,208 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dispatch.h"
 #include "engine.h"
 #include "examples.h"
+#include "hint.h"
+#include "loadgen.h"
+#include "pipeline.h"
+#include "search.h"
+#include "server.h"
+#include "store.h"
 #include "tests.h"
+#include "trace.h"
+
+static const int kStoreLog2Slots = 20;  // slots in a new store file (96 MB, sparse until filled)
+
+/**
+ Print command line usage to standard error.
+
+ @param program Name of the executable.
+ */
+static void PrintUsage(const char *program) {
+    fprintf(stderr, "Usage: %s                          solve the built-in example\n", program);
+    fprintf(stderr, "       %s --test                   run the regression tests\n", program);
+    fprintf(stderr, "       %s --search PUZZLE [THREADS] solve PUZZLE by search, checking uniqueness\n", program);
+    fprintf(stderr, "       %s --hints PUZZLE           list the logical steps for PUZZLE\n", program);
+    fprintf(stderr, "       %s --serve PATH [WORKERS [STORE]] serve on a Unix domain socket\n", program);
+    fprintf(stderr, "       %s --batch [WORKERS [STORE]] solve one puzzle per line from standard input\n", program);
+    fprintf(stderr, "       (STORE is a file of known solutions shared between runs)\n");
+    fprintf(stderr, "       %s --load [THREADS [RATE [SECONDS [HARD%% [CLUSTERS%% [CORPUS]]]]]]\n", program);
+    fprintf(stderr, "              measure latency and throughput under load (RATE 0: as fast as possible)\n");
+    fprintf(stderr, "       %s --trace FILE PUZZLE      solve PUZZLE by search on one thread, tracing to FILE\n", program);
+    fprintf(stderr, "       %s --decode FILE            print a trace written by --trace\n", program);
+}
 
 int main(int argc, const char * argv[]) {
-    TestAll();
-    
+    if (argc >= 2 && strcmp(argv[1], "--test") == 0) {
+        TestAll();
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--search") == 0) {
+        struct SudokuBoard board;
+        struct SearchOptions options = DefaultSearchOptions();
+        options.max_solutions = 2;
+        if (argc >= 4)
+            options.num_threads = atoi(argv[3]);
+        if (strlen(argv[2]) != 81 || !BoardFromString(&board, argv[2])) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        
+        PrintBoard(&board);
+        struct SearchResult result = SearchBoard(&board, &options);
+        if (result.num_solutions > 0)
+            PrintBoard(&board);
+        printf("%s (%ld nodes)\n", result.num_solutions == 0 ? "No solution" :
+               result.num_solutions == 1 ? "Unique solution" : "Multiple solutions", result.nodes);
+        return result.num_solutions == 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--hints") == 0) {
+        struct SudokuBoard board;
+        struct HintState state;
+        struct Hint hint;
+        if (strlen(argv[2]) != 81 || !BoardFromString(&board, argv[2])) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        
+        InitHintState(&state, &board);
+        while (NextHint(&state, &hint))
+            PrintHint(&hint, stdout);
+        PrintBoard(&state.board);
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+        struct ServerOptions options = DefaultServerOptions();
+        if (argc >= 4)
+            options.num_workers = atoi(argv[3]);
+        if (options.num_workers < 1) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        if (argc >= 5 && (options.store = OpenSolutionStore(argv[4], kStoreLog2Slots)) == NULL) {
+            fprintf(stderr, "%s: cannot open solution store\n", argv[4]);
+            return 1;
+        }
+        int result = RunServer(argv[2], &options);
+        if (options.store != NULL)
+            CloseSolutionStore(options.store);
+        return result;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        struct PipelineOptions options = DefaultPipelineOptions();
+        struct PipelineStats stats;
+        if (argc >= 3)
+            options.num_workers = atoi(argv[2]);
+        if (options.num_workers < 1) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        if (argc >= 4 && (options.store = OpenSolutionStore(argv[3], kStoreLog2Slots)) == NULL) {
+            fprintf(stderr, "%s: cannot open solution store\n", argv[3]);
+            return 1;
+        }
+        
+        int result = RunPipeline(stdin, stdout, &options, &stats);
+        fprintf(stderr, "%ld puzzles: %ld solved (%ld known), %ld unsolved, %ld malformed\n", stats.puzzles,
+                stats.solved, stats.known, stats.puzzles - stats.solved - stats.malformed, stats.malformed);
+        PrintDispatchStats(&stats.dispatch, stderr);
+        if (options.store != NULL)
+            CloseSolutionStore(options.store);
+        return result;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--load") == 0) {
+        struct LoadOptions options = DefaultLoadOptions();
+        struct LoadResult result;
+        char **corpus = NULL;
+        if (argc >= 3)
+            options.num_threads = atoi(argv[2]);
+        if (argc >= 4)
+            options.rate = atof(argv[3]);
+        if (argc >= 5)
+            options.seconds = atof(argv[4]);
+        if (argc >= 6)
+            options.hard_fraction = atof(argv[5]) / 100.0;
+        if (argc >= 7)
+            options.cluster_fraction = atof(argv[6]) / 100.0;
+        if (options.num_threads < 1 || options.rate < 0.0 || options.seconds <= 0.0 ||
+            options.hard_fraction < 0.0 || options.cluster_fraction < 0.0 ||
+            options.hard_fraction + options.cluster_fraction > 1.0) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        if (argc >= 8) {
+            FILE *input = fopen(argv[7], "r");
+            if (input == NULL) {
+                perror(argv[7]);
+                return 1;
+            }
+            options.corpus_size = ReadLoadCorpus(input, &corpus);
+            options.corpus = (char const *const *) corpus;
+            fclose(input);
+        }
+        
+        int status = RunLoad(&options, &result);
+        if (status == 0)
+            PrintLoadResult(&result, stdout);
+        else
+            fprintf(stderr, "Could not run the load\n");
+        FreeLoadCorpus(corpus, options.corpus_size);
+        return status;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--trace") == 0) {
+        struct SudokuBoard board;
+        struct SearchOptions options = DefaultSearchOptions();
+        options.max_solutions = 2;
+        if (strlen(argv[3]) != 81 || !BoardFromString(&board, argv[3])) {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        
+        // Parse again with the ring attached so that the clues are traced too.
+        struct TraceRing *ring = NewTraceRing(20);
+        AttachTraceRing(ring);
+        BoardFromString(&board, argv[3]);
+        struct SearchResult result = SearchBoard(&board, &options);
+        AttachTraceRing(NULL);
+        
+        bool written = WriteTraceFile(ring, argv[2]);
+        fprintf(stderr, "%llu events, %d solutions\n", (unsigned long long) ring->count, result.num_solutions);
+        FreeTraceRing(ring);
+        if (!written) {
+            perror(argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--decode") == 0) {
+        if (!PrintTraceFile(argv[2])) {
+            fprintf(stderr, "%s: not a readable trace\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc != 1) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
     struct SudokuBoard *board_ptr = example1();
     PrintBoard(board_ptr);
-    
+
     SolveBoard(board_ptr);
     PrintBoard(board_ptr);
-    
+
     return 0;
 }
@@ -0,0 +1,346 @@
+//
+//  pipeline.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dispatch.h"
+#include "engine.h"
+#include "pipeline.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "store.h"
+
+/*
+ Batch solving of large input files as a three-stage pipeline.
+
+ The parser (on the calling thread) reads lines into batches of boards, a pool
+ of workers solves the batches, and the writer formats them and writes them out
+ in input order. The stages are connected by lock-free queues, so a stage
+ stalled on I/O does not hold up the others.
+
+ A fixed set of batch buffers circulates: free -> parser -> workers -> writer
+ -> free. Nothing is allocated per puzzle, and the number of buffers bounds both
+ the memory in use and how far the parser can run ahead of the writer. Workers
+ finish batches out of order; the writer parks early ones in a reorder window
+ that needs one slot per buffer, since no two batches in flight can be more
+ than num_batches apart.
+
+ A batch with no puzzles marks the end of the input. It passes through a worker
+ like any other batch and, because it comes last, tells the writer that
+ everything has been written. Each worker is stopped by a NULL batch.
+ */
+
+#define kBoardChars 81             // kMaxNumber * kMaxNumber
+#define kLineChars (kBoardChars + 1)   // a formatted board and its newline
+#define kReadBufferChars (kBoardChars + 3) // a puzzle line with "\r\n" and the terminator
+
+enum PuzzleStatus {
+    kPuzzleMalformed,
+    kPuzzleUnsolved,
+    kPuzzleSolved,
+    kPuzzleKnown                   // solved by the store
+};
+
+struct PuzzleBatch {
+    long sequence;
+    int size;                      // 0 marks the end of the input
+    struct SudokuBoard *boards;
+    uint8_t *status;               // enum PuzzleStatus per board
+};
+
+struct Pipeline {
+    struct PipelineOptions options;
+    struct BoundedQueue *free_batches;
+    struct BoundedQueue *solve_batches;
+    struct BoundedQueue *write_batches;
+    FILE *output;
+    struct PipelineStats stats;    // written by the writer only, but for dispatch
+    pthread_mutex_t dispatch_mutex; // guards stats.dispatch, which workers add to when they stop
+};
+
+
+/**
+ Return the default pipeline options: one worker per online processor and no
+ solution store.
+
+ @return struct PipelineOptions.
+ */
+struct PipelineOptions DefaultPipelineOptions() {
+    struct PipelineOptions options;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    options.num_workers = num_cpus > 0 ? (int) num_cpus : 1;
+    options.batch_size = 64;
+    options.num_batches = 4 * options.num_workers + 4;
+    options.store = NULL;
+
+    return options;
+}
+
+
+/**
+ Read one line, without its line end. A line too long for the buffer is
+ consumed entirely but returned empty, since it cannot be a puzzle.
+
+ @param input The input stream.
+ @param line Buffer of kReadBufferChars characters. Receives the line, null terminated.
+ @return false at the end of the input.
+ */
+static bool ReadLine(FILE *input, char line[kReadBufferChars]) {
+    if (fgets(line, kReadBufferChars, input) == NULL)
+        return false;
+
+    size_t length = strlen(line);
+    if (length > 0 && line[length - 1] != '\n' && !feof(input)) {
+        int symbol;
+        while ((symbol = getc(input)) != EOF && symbol != '\n')
+            ;
+        line[0] = '\0';
+        return true;
+    }
+
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        line[--length] = '\0';
+
+    return true;
+}
+
+
+/**
+ Solver worker: solve batches with SolveBoardTiered() until a NULL batch
+ arrives, then add its dispatch stats to the pipeline's.
+
+ @param arg Pointer to struct Pipeline.
+ @return NULL.
+ */
+static void *PipelineWorkerMain(void *arg) {
+    struct Pipeline *pipeline = arg;
+    struct SolutionStore *store = pipeline->options.store;
+    struct SolveScheduler scheduler;
+    struct DispatchStats dispatch;
+    struct PuzzleBatch *batch;
+
+    InitSolveScheduler(&scheduler);
+    InitDispatchStats(&dispatch);
+
+    while ((batch = PopQueue(pipeline->solve_batches)) != NULL) {
+        for (int index = 0; index < batch->size; ++index) {
+            struct SudokuBoard *board_ptr = &batch->boards[index];
+            if (batch->status[index] == kPuzzleMalformed)
+                continue;
+            if (store != NULL && LookupSolution(store, board_ptr, board_ptr)) {
+                batch->status[index] = kPuzzleKnown;
+                continue;
+            }
+
+            struct SudokuBoard puzzle = *board_ptr;
+            bool solved = SolveBoardTiered(board_ptr, &scheduler, &dispatch);
+            batch->status[index] = solved ? kPuzzleSolved : kPuzzleUnsolved;
+            if (store != NULL && batch->status[index] == kPuzzleSolved)
+                StoreSolution(store, &puzzle, board_ptr);
+        }
+        PushQueue(pipeline->write_batches, batch);
+    }
+
+    pthread_mutex_lock(&pipeline->dispatch_mutex);
+    AddDispatchStats(&pipeline->stats.dispatch, &dispatch);
+    pthread_mutex_unlock(&pipeline->dispatch_mutex);
+
+    return NULL;
+}
+
+
+/**
+ Format a batch and write it out.
+
+ @param pipeline The pipeline.
+ @param batch The batch.
+ @param text Buffer of batch_size * kLineChars characters.
+ */
+static void WriteBatch(struct Pipeline *pipeline, struct PuzzleBatch const *batch, char *text) {
+    char *end = text;
+
+    for (int index = 0; index < batch->size; ++index) {
+        if (batch->status[index] != kPuzzleMalformed) {
+            BoardToString(&batch->boards[index], end);
+            end += kBoardChars;
+        }
+        *end++ = '\n';
+
+        ++pipeline->stats.puzzles;
+        pipeline->stats.solved += batch->status[index] == kPuzzleSolved || batch->status[index] == kPuzzleKnown;
+        pipeline->stats.known += batch->status[index] == kPuzzleKnown;
+        pipeline->stats.malformed += batch->status[index] == kPuzzleMalformed;
+    }
+
+    fwrite(text, 1, (size_t) (end - text), pipeline->output);
+}
+
+
+/**
+ Writer: write batches in sequence and recycle them, until the empty batch
+ that ends the input has been reached.
+
+ @param arg Pointer to struct Pipeline.
+ @return NULL.
+ */
+static void *PipelineWriterMain(void *arg) {
+    struct Pipeline *pipeline = arg;
+    int num_batches = pipeline->options.num_batches;
+    struct PuzzleBatch **window = calloc(num_batches, sizeof(struct PuzzleBatch *));
+    char *text = malloc(pipeline->options.batch_size * kLineChars);
+    long next_sequence = 0;
+    bool done = false;
+
+    while (!done) {
+        struct PuzzleBatch *batch = PopQueue(pipeline->write_batches);
+        window[batch->sequence % num_batches] = batch;
+
+        while (!done && (batch = window[next_sequence % num_batches]) != NULL) {
+            window[next_sequence % num_batches] = NULL;
+            ++next_sequence;
+            done = batch->size == 0;
+            WriteBatch(pipeline, batch, text);
+            PushQueue(pipeline->free_batches, batch);
+        }
+    }
+    fflush(pipeline->output);
+
+    free(text);
+    free(window);
+    return NULL;
+}
+
+
+/**
+ Read the input into batches and hand them to the workers, ending with an
+ empty batch.
+
+ @param pipeline The pipeline.
+ @param input The input stream.
+ */
+static void ParseInput(struct Pipeline *pipeline, FILE *input) {
+    char line[kReadBufferChars];
+    long sequence = 0;
+    bool more = true;
+    int size;
+
+    do {
+        struct PuzzleBatch *batch = PopQueue(pipeline->free_batches);
+        batch->sequence = sequence++;
+        batch->size = 0;
+
+        while (more && batch->size < pipeline->options.batch_size && (more = ReadLine(input, line))) {
+            bool ok = strlen(line) == kBoardChars && BoardFromString(&batch->boards[batch->size], line);
+            batch->status[batch->size] = ok ? kPuzzleUnsolved : kPuzzleMalformed;
+            ++batch->size;
+        }
+
+        // The batch belongs to the workers once it is pushed.
+        size = batch->size;
+        PushQueue(pipeline->solve_batches, batch);
+    } while (size > 0);
+}
+
+
+/**
+ Return the smallest log2 of a power of two that is at least value.
+
+ @param value A positive number.
+ @return The exponent.
+ */
+static int CeilLog2(int value) {
+    int log2 = 0;
+
+    while ((1 << log2) < value)
+        ++log2;
+
+    return log2;
+}
+
+
+/**
+ Solve every puzzle on input and write the results to output, one line per
+ input line in the same order (see pipeline.h).
+
+ @param input The input stream.
+ @param output The output stream.
+ @param options Number of workers and batch buffers, and the solution store if any.
+ @param stats Receives the puzzle counts.
+ @return Non-zero if the threads could not be started or writing failed.
+ */
+int RunPipeline(FILE *input, FILE *output, struct PipelineOptions const *options, struct PipelineStats *stats) {
+    struct Pipeline pipeline;
+    int num_workers = options->num_workers > 1 ? options->num_workers : 1;
+    int result = 0;
+
+    pipeline.options = *options;
+    pipeline.options.num_workers = num_workers;
+    pipeline.options.batch_size = options->batch_size > 1 ? options->batch_size : 1;
+    pipeline.options.num_batches = options->num_batches > 1 ? options->num_batches : 1;
+    pipeline.output = output;
+    memset(&pipeline.stats, 0, sizeof pipeline.stats);
+    InitDispatchStats(&pipeline.stats.dispatch);
+    pthread_mutex_init(&pipeline.dispatch_mutex, NULL);
+
+    int num_batches = pipeline.options.num_batches;
+    int batch_size = pipeline.options.batch_size;
+    int log2_capacity = CeilLog2(num_batches + num_workers);
+    pipeline.free_batches = NewBoundedQueue(log2_capacity);
+    pipeline.solve_batches = NewBoundedQueue(log2_capacity);
+    pipeline.write_batches = NewBoundedQueue(log2_capacity);
+
+    struct PuzzleBatch *batches = malloc(num_batches * sizeof(struct PuzzleBatch));
+    for (int index = 0; index < num_batches; ++index) {
+        batches[index].boards = malloc(batch_size * sizeof(struct SudokuBoard));
+        batches[index].status = malloc(batch_size * sizeof(uint8_t));
+        PushQueue(pipeline.free_batches, &batches[index]);
+    }
+
+    pthread_t *workers = malloc(num_workers * sizeof(pthread_t));
+    pthread_t writer;
+    int started = 0;
+    while (started < num_workers &&
+           pthread_create(&workers[started], NULL, PipelineWorkerMain, &pipeline) == 0)
+        ++started;
+
+    if (started == 0 || pthread_create(&writer, NULL, PipelineWriterMain, &pipeline) != 0) {
+        fprintf(stderr, "Could not start pipeline threads\n");
+        result = 1;
+    }
+    else {
+        ParseInput(&pipeline, input);
+        pthread_join(writer, NULL);
+    }
+
+    for (int worker = 0; worker < started; ++worker)
+        PushQueue(pipeline.solve_batches, NULL);
+    for (int worker = 0; worker < started; ++worker)
+        pthread_join(workers[worker], NULL);
+
+    if (ferror(output))
+        result = 1;
+    *stats = pipeline.stats;
+
+    for (int index = 0; index < num_batches; ++index) {
+        free(batches[index].boards);
+        free(batches[index].status);
+    }
+    free(batches);
+    free(workers);
+    pthread_mutex_destroy(&pipeline.dispatch_mutex);
+    FreeBoundedQueue(pipeline.free_batches);
+    FreeBoundedQueue(pipeline.solve_batches);
+    FreeBoundedQueue(pipeline.write_batches);
+
+    return result;
+}
@@ -0,0 +1,43 @@
+//
+//  pipeline.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef pipeline_h
+#define pipeline_h
+
+#include <stdio.h>
+#include "dispatch.h"
+
+struct SolutionStore;
+
+/**
+ Input: one puzzle per line in the format of BoardFromString().
+ Output: one line per input line, in input order. A puzzle is written as its
+ solution, or if it has none or more than one as far as it could be reduced, with '.' for the
+ cells that are still open; a line that is not a puzzle is written as an empty
+ line.
+ */
+
+struct PipelineOptions {
+    int num_workers;   // solver threads
+    int batch_size;    // puzzles per batch
+    int num_batches;   // batch buffers circulating between the stages
+    struct SolutionStore *store; // known solutions, consulted and extended; NULL for none
+};
+
+struct PipelineStats {
+    long puzzles;      // input lines
+    long solved;
+    long known;        // solved puzzles answered from the store
+    long malformed;
+    struct DispatchStats dispatch; // how the puzzles not known to the store were solved
+};
+
+struct PipelineOptions DefaultPipelineOptions();
+int RunPipeline(FILE *input, FILE *output, struct PipelineOptions const *options, struct PipelineStats *stats);
+
+#endif /* pipeline_h */
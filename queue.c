@@ -0,0 +1,191 @@
+//
+//  queue.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "queue.h"
+
+/*
+ A bounded multi-producer, multi-consumer queue of pointers without locks.
+
+ Each slot carries a sequence number that says whose turn it is: a producer
+ may fill the slot for position pos once the sequence equals pos, a consumer
+ may empty it once the sequence equals pos + 1. Producers and consumers each
+ claim positions with a compare-and-swap on their own counter, so they only
+ contend with their own kind, and a full or empty queue is detected without
+ touching the other side's counter.
+
+ The blocking variants spin politely: they yield the processor for a while
+ and then sleep in short intervals, so an idle stage costs little CPU.
+ */
+
+#define kCacheLineBytes 64
+#define kYieldAttempts 64
+
+struct QueueSlot {
+    _Atomic size_t sequence;
+    void *item;
+};
+
+struct BoundedQueue {
+    struct QueueSlot *slots;
+    size_t mask;                                         // capacity - 1
+    _Alignas(kCacheLineBytes) _Atomic size_t push_position;
+    _Alignas(kCacheLineBytes) _Atomic size_t pop_position;
+};
+
+
+/**
+ Allocate an empty queue.
+
+ @param log2_capacity The queue holds 2^log2_capacity items.
+ @return Pointer to the queue; free with FreeBoundedQueue().
+ */
+struct BoundedQueue *NewBoundedQueue(int log2_capacity) {
+    struct BoundedQueue *queue = aligned_alloc(kCacheLineBytes, sizeof(struct BoundedQueue));
+    size_t capacity = (size_t) 1 << log2_capacity;
+
+    queue->slots = malloc(capacity * sizeof(struct QueueSlot));
+    queue->mask = capacity - 1;
+    for (size_t position = 0; position < capacity; ++position)
+        atomic_init(&queue->slots[position].sequence, position);
+    atomic_init(&queue->push_position, 0);
+    atomic_init(&queue->pop_position, 0);
+
+    return queue;
+}
+
+
+/**
+ Free a queue. Items still on it are not freed.
+
+ @param queue The queue.
+ */
+void FreeBoundedQueue(struct BoundedQueue *queue) {
+    free(queue->slots);
+    free(queue);
+}
+
+
+/**
+ Append an item unless the queue is full. Safe to call from any thread.
+
+ @param queue The queue.
+ @param item The item; may be NULL.
+ @return false if the queue was full.
+ */
+bool TryPushQueue(struct BoundedQueue *queue, void *item) {
+    size_t position = atomic_load_explicit(&queue->push_position, memory_order_relaxed);
+    struct QueueSlot *slot;
+
+    while (true) {
+        slot = &queue->slots[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->push_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = atomic_load_explicit(&queue->push_position, memory_order_relaxed);
+    }
+
+    slot->item = item;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+    return true;
+}
+
+
+/**
+ Remove the oldest item unless the queue is empty. Safe to call from any thread.
+
+ @param queue The queue.
+ @param item_ptr Receives the item.
+ @return false if the queue was empty.
+ */
+bool TryPopQueue(struct BoundedQueue *queue, void **item_ptr) {
+    size_t position = atomic_load_explicit(&queue->pop_position, memory_order_relaxed);
+    struct QueueSlot *slot;
+
+    while (true) {
+        slot = &queue->slots[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->pop_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = atomic_load_explicit(&queue->pop_position, memory_order_relaxed);
+    }
+
+    *item_ptr = slot->item;
+    atomic_store_explicit(&slot->sequence, position + queue->mask + 1, memory_order_release);
+
+    return true;
+}
+
+
+/**
+ Wait a little before retrying a full or empty queue.
+
+ @param attempts Number of failed attempts so far. Will be incremented.
+ */
+static void Backoff(int *attempts) {
+    static const struct timespec pause = {0, 50000};
+
+    if (*attempts < kYieldAttempts) {
+        ++*attempts;
+        sched_yield();
+    }
+    else
+        nanosleep(&pause, NULL);
+}
+
+
+/**
+ Append an item, waiting while the queue is full.
+
+ @param queue The queue.
+ @param item The item; may be NULL.
+ */
+void PushQueue(struct BoundedQueue *queue, void *item) {
+    int attempts = 0;
+
+    while (!TryPushQueue(queue, item))
+        Backoff(&attempts);
+}
+
+
+/**
+ Remove the oldest item, waiting while the queue is empty.
+
+ @param queue The queue.
+ @return The item.
+ */
+void *PopQueue(struct BoundedQueue *queue) {
+    int attempts = 0;
+    void *item;
+
+    while (!TryPopQueue(queue, &item))
+        Backoff(&attempts);
+
+    return item;
+}
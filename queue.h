@@ -0,0 +1,23 @@
+//
+//  queue.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef queue_h
+#define queue_h
+
+#include <stdbool.h>
+
+struct BoundedQueue;
+
+struct BoundedQueue *NewBoundedQueue(int log2_capacity);
+void FreeBoundedQueue(struct BoundedQueue *queue);
+bool TryPushQueue(struct BoundedQueue *queue, void *item);
+bool TryPopQueue(struct BoundedQueue *queue, void **item_ptr);
+void PushQueue(struct BoundedQueue *queue, void *item);
+void *PopQueue(struct BoundedQueue *queue);
+
+#endif /* queue_h */
@@ -0,0 +1,236 @@
+//
+//  scheduler.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stdio.h>
+#include <time.h>
+#include "engine.h"
+#include "scheduler.h"
+#include "trace.h"
+
+/*
+ Adaptive alternative to the fixed rows/columns/squares loop of SolveBoard().
+
+ Techniques are split in two tiers: the cheap singles techniques and the
+ expensive cluster techniques. The cheap tier is repeated until it stalls.
+ Only then is the expensive tier tried, and as soon as one expensive technique
+ eliminates anything we drop back to the cheap tier; the remaining expensive
+ techniques are skipped for that round. Within a tier, techniques are tried in
+ order of their recent yield per unit of time, so the most productive unit
+ type for the current workload goes first.
+
+ The board ends in the same state as with SolveBoard(): we stop only when
+ every technique has been tried on the current board without effect.
+ */
+
+/**
+ Weight of the newest observation in the decayed score of a technique.
+ */
+static const double kScoreDecay = 0.25;
+
+static const enum Technique kCheapTier[] = {
+    kTechniqueRowSingles, kTechniqueColumnSingles, kTechniqueSquareSingles
+};
+
+static const enum Technique kExpensiveTier[] = {
+    kTechniqueRowClusters, kTechniqueColumnClusters, kTechniqueSquareClusters
+};
+
+#define kTierSize 3
+
+
+/**
+ Reset all statistics of the scheduler. A scheduler may be reused for many
+ boards, in which case it learns across the whole batch.
+
+ @param scheduler The scheduler to initialize.
+ */
+void InitSolveScheduler(struct SolveScheduler *scheduler) {
+    for (int technique = 0; technique < kNumTechniques; ++technique) {
+        scheduler->stats[technique].calls = 0;
+        scheduler->stats[technique].eliminations = 0;
+        scheduler->stats[technique].nanoseconds = 0;
+        scheduler->stats[technique].score = 0.0;
+    }
+}
+
+
+/**
+ Return the current value of a monotonic clock in nanoseconds.
+
+ @return Nanoseconds since an arbitrary point in time.
+ */
+static long NowNanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+
+/**
+ Remove the values of solved cells from the other cells of the unit.
+
+ @param cells Array of kMaxNumber cells. Will be modified.
+ */
+static void FilterCellsBySingles(struct SudokuCell cells[kMaxNumber]) {
+    int solved_bits = 0;
+
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles;
+        if (bits != 0 && (bits & (bits - 1)) == 0)
+            solved_bits |= bits;
+    }
+
+    for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index) {
+        int bits = cells[cell_index].possibles;
+        if ((bits & (bits - 1)) != 0)
+            cells[cell_index].possibles = bits & ~solved_bits;
+    }
+}
+
+
+/**
+ Apply a technique to every unit of its type and return the number of
+ candidates eliminated.
+
+ @param board_ptr Pointer to the sudoku board. Will be modified.
+ @param technique The technique to apply.
+ @return Number of candidates removed from the board.
+ */
+static int ApplyTechnique(struct SudokuBoard *board_ptr, enum Technique technique) {
+    int first_unit = (technique % kTierSize) * kMaxNumber;
+    bool use_clusters = technique >= kTechniqueRowClusters;
+    int eliminations = 0;
+    struct SudokuCell cells[kMaxNumber];
+
+    for (int unit = first_unit; unit < first_unit + kMaxNumber; ++unit) {
+        GetUnitCells(board_ptr, unit, cells);
+
+        int before = 0;
+        for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index)
+            before += BitCount(cells[cell_index].possibles);
+
+        if (use_clusters) {
+            struct LineClusterGroups clusters = FindLineClusters(cells);
+            FilterCellsByClusters(cells, &clusters);
+            FreeLineClusterGroups(&clusters);
+        }
+        else {
+            FilterCellsBySingles(cells);
+        }
+
+        int after = 0;
+        for (int cell_index = 0; cell_index < kMaxNumber; ++cell_index)
+            after += BitCount(cells[cell_index].possibles);
+
+        if (after != before) {
+            SetTraceContext(use_clusters ? kTraceClusters : kTraceSingles, unit);
+            SetUnitCells(board_ptr, unit, cells);
+            eliminations += before - after;
+        }
+    }
+
+    return eliminations;
+}
+
+
+/**
+ Apply a technique and record its cost and yield.
+
+ @param board_ptr Pointer to the sudoku board. Will be modified.
+ @param scheduler The scheduler whose statistics are updated.
+ @param technique The technique to apply.
+ @return Number of candidates removed from the board.
+ */
+static int RunTechnique(struct SudokuBoard *board_ptr, struct SolveScheduler *scheduler,
+                        enum Technique technique) {
+    struct TechniqueStats *stats = &scheduler->stats[technique];
+
+    long start = NowNanoseconds();
+    int eliminations = ApplyTechnique(board_ptr, technique);
+    long elapsed = NowNanoseconds() - start;
+
+    ++stats->calls;
+    stats->eliminations += eliminations;
+    stats->nanoseconds += elapsed;
+
+    double rate = 1000.0 * eliminations / (elapsed > 0 ? elapsed : 1);
+    stats->score = (1.0 - kScoreDecay) * stats->score + kScoreDecay * rate;
+
+    return eliminations;
+}
+
+
+/**
+ Write the techniques of a tier into order, best score first. Ties keep the
+ rows, columns, squares order of SolveBoard().
+
+ @param scheduler The scheduler.
+ @param tier Array of kTierSize techniques.
+ @param order Receives the sorted techniques.
+ */
+static void OrderTier(struct SolveScheduler const *scheduler, enum Technique const tier[kTierSize],
+                      enum Technique order[kTierSize]) {
+    for (int index = 0; index < kTierSize; ++index) {
+        int insert_at = index;
+        while (insert_at > 0 &&
+               scheduler->stats[order[insert_at - 1]].score < scheduler->stats[tier[index]].score) {
+            order[insert_at] = order[insert_at - 1];
+            --insert_at;
+        }
+        order[insert_at] = tier[index];
+    }
+}
+
+
+/**
+ Reduce possibilities in each cell as much as SolveBoard() does, choosing the
+ order of the work from the statistics gathered so far.
+
+ @param board_ptr Pointer to the suduko puzzle to be solved. The board will be modified.
+ @param scheduler Scheduler holding the statistics. Updated with this solve.
+ */
+void SolveBoardScheduled(struct SudokuBoard *board_ptr, struct SolveScheduler *scheduler) {
+    enum Technique order[kTierSize];
+    bool progress;
+
+    do {
+        // Cheap tier until it stalls.
+        do {
+            progress = false;
+            OrderTier(scheduler, kCheapTier, order);
+            for (int index = 0; index < kTierSize; ++index)
+                if (RunTechnique(board_ptr, scheduler, order[index]) > 0)
+                    progress = true;
+        } while (progress);
+
+        // Escalate, but only as far as the first expensive technique that helps.
+        OrderTier(scheduler, kExpensiveTier, order);
+        for (int index = 0; index < kTierSize && !progress; ++index)
+            if (RunTechnique(board_ptr, scheduler, order[index]) > 0)
+                progress = true;
+    } while (progress);
+}
+
+
+/**
+ Print the statistics of the scheduler to standard output.
+
+ @param scheduler The scheduler.
+ */
+void PrintSchedulerStats(struct SolveScheduler const *scheduler) {
+    static char const *names[kNumTechniques] = {
+        "row singles", "column singles", "square singles",
+        "row clusters", "column clusters", "square clusters"
+    };
+
+    for (int technique = 0; technique < kNumTechniques; ++technique) {
+        struct TechniqueStats const *stats = &scheduler->stats[technique];
+        printf("%-16s calls %8ld  eliminations %8ld  time %10ld ns  score %.3f\n",
+               names[technique], stats->calls, stats->eliminations, stats->nanoseconds, stats->score);
+    }
+}
@@ -0,0 +1,45 @@
+//
+//  scheduler.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include "engine.h"
+
+/**
+ Techniques known to the scheduler. Each is one kind of reasoning applied to
+ all units of one type. The singles techniques only remove the values of
+ solved cells from the rest of the unit; the cluster techniques run the full
+ FindLineClusters()/FilterCellsByClusters() logic.
+ */
+enum Technique {
+    kTechniqueRowSingles,
+    kTechniqueColumnSingles,
+    kTechniqueSquareSingles,
+    kTechniqueRowClusters,
+    kTechniqueColumnClusters,
+    kTechniqueSquareClusters,
+    kNumTechniques
+};
+
+struct TechniqueStats {
+    long calls;
+    long eliminations;  // candidates removed in total
+    long nanoseconds;   // time spent in total
+    double score;       // recent eliminations per microsecond (exponentially decayed)
+};
+
+struct SolveScheduler {
+    struct TechniqueStats stats[kNumTechniques];
+};
+
+void InitSolveScheduler(struct SolveScheduler *scheduler);
+void SolveBoardScheduled(struct SudokuBoard *board_ptr, struct SolveScheduler *scheduler);
+void PrintSchedulerStats(struct SolveScheduler const *scheduler);
+
+#endif /* scheduler_h */
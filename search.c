@@ -0,0 +1,433 @@
+//
+//  search.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include "engine.h"
+#include "scheduler.h"
+#include "search.h"
+#include "trace.h"
+
+/*
+ Depth-first search for puzzles that elimination alone does not finish.
+
+ Every node is propagated with SolveBoardScheduled() (SolveBoardWithLayout()
+ for variant puzzles) and then split on the cell with the fewest possible
+ values. A worker explores children in place
+ and rolls back through its trail, so a branch costs the cells it changes
+ rather than a copy of the board. With more than one thread, the search
+ tree of the single puzzle is shared through work stealing: each worker owns
+ a deque of unexplored boards, works depth-first on its own subtree and only
+ pushes a sibling onto its deque while some other worker is idle. Idle workers
+ steal from the top of the other deques, which holds the shallowest (and so
+ largest) subtrees. A worker that finds nothing to steal yields a few times
+ and then sleeps briefly between attempts, so idle workers do not hold a core
+ each through the tail of a search.
+
+ All workers watch a shared cancellation flag, raised as soon as
+ max_solutions solutions have been found.
+ */
+
+#define kDequeCapacity 64
+#define kIdleYields 64
+
+struct WorkDeque {
+    pthread_mutex_t mutex;
+    struct SudokuBoard boards[kDequeCapacity];
+    int top;    // index of the oldest board; thieves take from here
+    int count;
+};
+
+struct SearchShared {
+    struct SearchOptions options;
+    struct WorkDeque *deques;
+    atomic_long pending;        // boards pushed or being explored, not yet finished
+    atomic_int idle_workers;
+    atomic_int solutions;
+    atomic_bool cancelled;
+    atomic_long nodes;
+    pthread_mutex_t solution_mutex;
+    struct SudokuBoard solution;
+};
+
+struct SearchWorker {
+    struct SearchShared *shared;
+    int id;
+    struct SolveScheduler scheduler;
+    long nodes;
+    struct Trail trail;     // undo log for exploring children in place
+};
+
+
+/**
+ Return the default search options: a single thread, stopping at the first solution.
+
+ @return struct SearchOptions.
+ */
+struct SearchOptions DefaultSearchOptions() {
+    struct SearchOptions options;
+    options.num_threads = 1;
+    options.max_solutions = 1;
+    options.layout = NULL;
+    return options;
+}
+
+
+/**
+ Push a board onto the bottom (owner's end) of a deque.
+
+ @param deque The deque.
+ @param board_ptr The board to copy.
+ @return false if the deque is full.
+ */
+static bool PushBottom(struct WorkDeque *deque, struct SudokuBoard const *board_ptr) {
+    bool pushed = false;
+
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count < kDequeCapacity) {
+        deque->boards[(deque->top + deque->count) % kDequeCapacity] = *board_ptr;
+        ++deque->count;
+        pushed = true;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+
+    return pushed;
+}
+
+
+/**
+ Pop the newest board from the bottom of a deque. Used by the owner.
+
+ @param deque The deque.
+ @param board_ptr Receives the board.
+ @return false if the deque was empty.
+ */
+static bool PopBottom(struct WorkDeque *deque, struct SudokuBoard *board_ptr) {
+    bool popped = false;
+
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0) {
+        --deque->count;
+        *board_ptr = deque->boards[(deque->top + deque->count) % kDequeCapacity];
+        popped = true;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+
+    return popped;
+}
+
+
+/**
+ Steal the oldest board from the top of a deque. Used by other workers.
+
+ @param deque The deque.
+ @param board_ptr Receives the board.
+ @return false if the deque was empty.
+ */
+static bool StealTop(struct WorkDeque *deque, struct SudokuBoard *board_ptr) {
+    bool stolen = false;
+
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0) {
+        *board_ptr = deque->boards[deque->top];
+        deque->top = (deque->top + 1) % kDequeCapacity;
+        --deque->count;
+        stolen = true;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+
+    return stolen;
+}
+
+
+/**
+ Register a solution and raise the cancellation flag once enough are known.
+
+ @param shared The shared search state.
+ @param board_ptr The solved board.
+ */
+static void RecordSolution(struct SearchShared *shared, struct SudokuBoard const *board_ptr) {
+    int previous = atomic_fetch_add(&shared->solutions, 1);
+
+    if (previous == 0) {
+        pthread_mutex_lock(&shared->solution_mutex);
+        shared->solution = *board_ptr;
+        pthread_mutex_unlock(&shared->solution_mutex);
+    }
+
+    if (previous + 1 >= shared->options.max_solutions)
+        atomic_store(&shared->cancelled, true);
+}
+
+
+/**
+ Return the position of the unsolved cell with the fewest possible values.
+
+ @param board_ptr Pointer to a board that is neither solved nor contradictory.
+ @param row_ptr Receives the row.
+ @param col_ptr Receives the column.
+ */
+static void ChooseBranchCell(struct SudokuBoard const *board_ptr, int *row_ptr, int *col_ptr) {
+    int best_count = kMaxNumber + 1;
+
+    for (int row = 0; row < kMaxNumber; ++row) {
+        for (int col = 0; col < kMaxNumber; ++col) {
+            int count = BitCount(board_ptr->cells[row][col].possibles);
+            if (count > 1 && count < best_count) {
+                best_count = count;
+                *row_ptr = row;
+                *col_ptr = col;
+                if (count == 2)
+                    return;
+            }
+        }
+    }
+}
+
+
+/**
+ Explore the subtree below a board depth-first, handing siblings to idle
+ workers when there are any.
+
+ @param worker The exploring worker.
+ @param board_ptr The board at the root of the subtree. Will be modified.
+ */
+static void Explore(struct SearchWorker *worker, struct SudokuBoard *board_ptr) {
+    struct SearchShared *shared = worker->shared;
+
+    if (atomic_load_explicit(&shared->cancelled, memory_order_relaxed))
+        return;
+
+    ++worker->nodes;
+    struct UnitLayout const *layout = shared->options.layout;
+    if (layout != NULL)
+        SolveBoardWithLayout(board_ptr, layout);
+    else
+        SolveBoardScheduled(board_ptr, &worker->scheduler);
+
+    if (layout != NULL ? IsLayoutContradictory(board_ptr, layout) : IsBoardContradictory(board_ptr))
+        return;
+
+    if (IsBoardSolved(board_ptr)) {
+        RecordSolution(shared, board_ptr);
+        return;
+    }
+
+    int row = 0, col = 0;
+    ChooseBranchCell(board_ptr, &row, &col);
+    int possibles = board_ptr->cells[row][col].possibles;
+    int remaining = BitCount(possibles);
+
+    for (int digit = 1; digit <= kMaxNumber; ++digit) {
+        if (!(possibles & (1 << (digit - 1))))
+            continue;
+        if (atomic_load_explicit(&shared->cancelled, memory_order_relaxed))
+            return;
+        --remaining;
+
+        // The last sibling is always explored here, so the worker keeps going depth-first.
+        if (remaining != 0 && atomic_load_explicit(&shared->idle_workers, memory_order_relaxed) > 0) {
+            struct SudokuBoard child = *board_ptr;
+            child.trail = NULL;
+            SetTraceContext(kTraceBranch, kTraceNoUnit);
+            SetCell(&child, row, col, digit);
+
+            atomic_fetch_add(&shared->pending, 1);
+            if (PushBottom(&shared->deques[worker->id], &child))
+                continue;
+            atomic_fetch_sub(&shared->pending, 1);
+        }
+
+        // Explore the child in place and roll the board back afterwards
+        // instead of copying it.
+        int checkpoint = MarkCheckpoint(board_ptr);
+        SetTraceContext(kTraceBranch, kTraceNoUnit);
+        SetCell(board_ptr, row, col, digit);
+        Explore(worker, board_ptr);
+        RestoreCheckpoint(board_ptr, checkpoint);
+    }
+}
+
+
+/**
+ Find a board to explore: the worker's own deque first, then the others'.
+
+ @param worker The worker looking for work.
+ @param board_ptr Receives the board.
+ @return true if a board was found.
+ */
+static bool FindWork(struct SearchWorker *worker, struct SudokuBoard *board_ptr) {
+    struct SearchShared *shared = worker->shared;
+
+    if (PopBottom(&shared->deques[worker->id], board_ptr))
+        return true;
+
+    for (int offset = 1; offset < shared->options.num_threads; ++offset) {
+        int victim = (worker->id + offset) % shared->options.num_threads;
+        if (StealTop(&shared->deques[victim], board_ptr))
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ Wait a little before looking for work again.
+
+ @param attempts Number of failed attempts so far. Will be incremented.
+ */
+static void IdleBackoff(int *attempts) {
+    static const struct timespec pause = {0, 50000};
+
+    if (*attempts < kIdleYields) {
+        ++*attempts;
+        sched_yield();
+    }
+    else
+        nanosleep(&pause, NULL);
+}
+
+
+/**
+ Worker thread: explore boards until the search is exhausted or cancelled.
+
+ @param arg Pointer to struct SearchWorker.
+ @return NULL.
+ */
+static void *SearchWorkerMain(void *arg) {
+    struct SearchWorker *worker = arg;
+    struct SearchShared *shared = worker->shared;
+    struct SudokuBoard board;
+    bool idle = false;
+    int idle_attempts = 0;
+
+    while (!atomic_load(&shared->cancelled)) {
+        if (FindWork(worker, &board)) {
+            if (idle) {
+                atomic_fetch_sub(&shared->idle_workers, 1);
+                idle = false;
+                idle_attempts = 0;
+            }
+            // The stolen board is a copy, so nothing on the trail from the
+            // previous one needs undoing; only its own changes are recorded.
+            worker->trail.size = 0;
+            board.trail = &worker->trail;
+            Explore(worker, &board);
+            atomic_fetch_sub(&shared->pending, 1);
+            continue;
+        }
+
+        if (atomic_load(&shared->pending) == 0)
+            break;
+
+        if (!idle) {
+            atomic_fetch_add(&shared->idle_workers, 1);
+            idle = true;
+        }
+        IdleBackoff(&idle_attempts);
+    }
+
+    if (idle)
+        atomic_fetch_sub(&shared->idle_workers, 1);
+    atomic_fetch_add(&shared->nodes, worker->nodes);
+
+    return NULL;
+}
+
+
+/**
+ Solve the board by elimination and, where that is not enough, by search.
+ If a solution is found, the board is overwritten with it (without being
+ recorded on its trail); otherwise it is left unchanged. With
+ max_solutions >= 2 the search continues after the first solution, which
+ tells whether the puzzle is unique. Only a one-thread search is recorded by
+ the caller's trace ring; worker threads have none.
+
+ @param board_ptr Pointer to the sudoku board. Will be modified.
+ @param options Number of threads and solutions to look for, and the layout
+    of a variant puzzle.
+ @return struct SearchResult with the number of solutions found and the work done.
+ */
+struct SearchResult SearchBoard(struct SudokuBoard *board_ptr, struct SearchOptions const *options) {
+    struct SearchShared shared;
+    struct SearchResult result;
+    int num_threads = options->num_threads > 1 ? options->num_threads : 1;
+
+    shared.options = *options;
+    shared.options.num_threads = num_threads;
+    atomic_init(&shared.pending, 1);
+    atomic_init(&shared.idle_workers, 0);
+    atomic_init(&shared.solutions, 0);
+    atomic_init(&shared.cancelled, false);
+    atomic_init(&shared.nodes, 0);
+    pthread_mutex_init(&shared.solution_mutex, NULL);
+
+    struct SearchWorker *workers = malloc(num_threads * sizeof(struct SearchWorker));
+    for (int id = 0; id < num_threads; ++id) {
+        workers[id].shared = &shared;
+        workers[id].id = id;
+        workers[id].nodes = 0;
+        InitTrail(&workers[id].trail);
+        InitSolveScheduler(&workers[id].scheduler);
+    }
+
+    if (num_threads == 1) {
+        struct SudokuBoard root = *board_ptr;
+        root.trail = &workers[0].trail;
+        shared.deques = NULL;
+        Explore(&workers[0], &root);
+        atomic_store(&shared.nodes, workers[0].nodes);
+    }
+    else {
+        shared.deques = malloc(num_threads * sizeof(struct WorkDeque));
+        for (int id = 0; id < num_threads; ++id) {
+            pthread_mutex_init(&shared.deques[id].mutex, NULL);
+            shared.deques[id].top = 0;
+            shared.deques[id].count = 0;
+        }
+        PushBottom(&shared.deques[0], board_ptr);
+
+        pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+        int started = 0;
+        while (started < num_threads &&
+               pthread_create(&threads[started], NULL, SearchWorkerMain, &workers[started]) == 0)
+            ++started;
+        // If fewer threads could be started, the others still drain every deque.
+        if (started == 0)
+            SearchWorkerMain(&workers[0]);
+        for (int id = 0; id < started; ++id)
+            pthread_join(threads[id], NULL);
+
+        for (int id = 0; id < num_threads; ++id)
+            pthread_mutex_destroy(&shared.deques[id].mutex);
+        free(threads);
+        free(shared.deques);
+    }
+
+    result.num_solutions = atomic_load(&shared.solutions);
+    if (result.num_solutions > options->max_solutions)
+        result.num_solutions = options->max_solutions;
+    if (result.num_solutions > 0) {
+        struct Trail *trail = board_ptr->trail;
+        *board_ptr = shared.solution;
+        board_ptr->trail = trail;
+    }
+    result.nodes = atomic_load(&shared.nodes);
+
+    pthread_mutex_destroy(&shared.solution_mutex);
+    for (int id = 0; id < num_threads; ++id)
+        FreeTrail(&workers[id].trail);
+    free(workers);
+
+    return result;
+}
@@ -0,0 +1,29 @@
+//
+//  search.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef search_h
+#define search_h
+
+#include "engine.h"
+#include "layout.h"
+
+struct SearchOptions {
+    int num_threads;    // 1 searches on the calling thread only
+    int max_solutions;  // stop once this many are found; 2 checks uniqueness
+    struct UnitLayout const *layout;  // variant units and cages; NULL for a classic puzzle
+};
+
+struct SearchResult {
+    int num_solutions;  // solutions found, at most max_solutions
+    long nodes;         // boards propagated during the search
+};
+
+struct SearchOptions DefaultSearchOptions();
+struct SearchResult SearchBoard(struct SudokuBoard *board_ptr, struct SearchOptions const *options);
+
+#endif /* search_h */
@@ -0,0 +1,662 @@
+//
+//  server.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L   // sigaction()
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "dispatch.h"
+#include "engine.h"
+#include "scheduler.h"
+#include "server.h"
+#include "store.h"
+
+/*
+ A long-running solver daemon listening on a Unix domain socket.
+
+ A fixed pool of worker threads is started once and shared by all connections.
+ Each connection gets a reader thread, which splits incoming batches into jobs
+ for the pool, and a writer thread, which streams the answers back as the
+ workers finish them.
+
+ Backpressure: a connection may have at most max_inflight puzzles read but not
+ yet written back. When the limit is reached the reader stops reading from the
+ socket, so a client that sends faster than it receives is throttled by the
+ kernel socket buffers instead of by unbounded memory on the server.
+
+ Puzzles are solved by SolveBoardTiered(). Each worker counts which tier
+ finished its puzzles and adds its counts to the server's every
+ kStatsFoldJobs jobs, whenever it finds the queue empty and when it exits, so
+ the totals are current whenever the server is idle; they go to standard error
+ every kStatsReportPuzzles puzzles and on shutdown.
+
+ SIGINT or SIGTERM stops the server: it stops accepting connections, the
+ workers finish the jobs already queued and exit, and RunServer() returns.
+ Connections still open at that point get no further answers.
+
+ A request frame with an impossible length cannot be resynchronized, so it is
+ logged, answered with one response of status kServerStatusBadFrame and the
+ connection is closed once the responses before it have been written.
+ */
+
+const uint8_t kServerStatusSolved = 0;
+const uint8_t kServerStatusUnsolved = 1;
+const uint8_t kServerStatusMalformed = 2;
+const uint8_t kServerStatusBadFrame = 3;
+const uint32_t kServerIndexNone = 0xffffffff;
+
+#define kBoardChars 81            // kMaxNumber * kMaxNumber
+#define kRequestHeaderBytes 4     // batch_id
+#define kResponseBodyBytes (4 + 4 + 1 + kBoardChars)
+#define kMaxFrameBytes (1 << 24)
+#define kReadBufferBytes (1 << 16)
+#define kWriteBatch 64
+#define kStatsFoldJobs 4096
+#define kStatsReportPuzzles (1L << 20)
+
+struct ServerConnection;
+
+struct ServerJob {
+    struct ServerConnection *conn;
+    uint32_t batch_id;
+    uint32_t index;
+    char puzzle[kBoardChars];
+};
+
+struct ServerResponse {
+    uint32_t batch_id;
+    uint32_t index;
+    uint8_t status;
+    char board[kBoardChars];
+};
+
+struct JobQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    struct ServerJob *jobs;
+    int capacity;
+    int head;
+    int count;
+    struct SolutionStore *store;   // handed to the workers along with the queue
+    struct DispatchStats stats;    // tiers of the puzzles solved so far, folded in by the workers
+    bool stopping;                 // workers exit once the queue is empty
+};
+
+struct ServerConnection {
+    int fd;
+    int max_inflight;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    struct ServerResponse *responses; // ring of max_inflight responses
+    int head;
+    int count;
+    int inflight;       // jobs handed to the pool whose response has not been written
+    bool reader_done;
+    bool broken;        // the peer went away; responses are discarded
+    struct JobQueue *queue;
+};
+
+struct BufferedReader {
+    int fd;
+    char buffer[kReadBufferBytes];
+    size_t start;
+    size_t end;
+};
+
+static volatile sig_atomic_t listen_socket = -1;  // shut down by StopServer() to end accept()
+
+
+/**
+ Push a job onto the queue, blocking while it is full.
+
+ @param queue The job queue.
+ @param job The job to copy onto the queue.
+ */
+static void PushJob(struct JobQueue *queue, struct ServerJob const *job) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+
+    queue->jobs[(queue->head + queue->count) % queue->capacity] = *job;
+    ++queue->count;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+
+/**
+ Add a worker's dispatch stats to the server's and reset them, reporting the
+ totals whenever they pass another kStatsReportPuzzles puzzles. The caller
+ holds the queue's mutex.
+
+ @param queue The job queue, which holds the server's stats.
+ @param stats The worker's stats. Reset.
+ */
+static void FoldDispatchStats(struct JobQueue *queue, struct DispatchStats *stats) {
+    long before = queue->stats.puzzles;
+    AddDispatchStats(&queue->stats, stats);
+    if (before / kStatsReportPuzzles != queue->stats.puzzles / kStatsReportPuzzles) {
+        fprintf(stderr, "%ld puzzles solved by tier:\n", queue->stats.puzzles);
+        PrintDispatchStats(&queue->stats, stderr);
+    }
+
+    InitDispatchStats(stats);
+}
+
+
+/**
+ Pop a job from the queue, blocking while it is empty. A worker about to wait
+ folds its stats first, so that an idle server reports current totals.
+
+ @param queue The job queue.
+ @param job Receives the job.
+ @param stats The worker's dispatch stats. Folded into the server's if the queue is empty.
+ @return false if the server is stopping and no job is left.
+ */
+static bool PopJob(struct JobQueue *queue, struct ServerJob *job, struct DispatchStats *stats) {
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count == 0 && stats->puzzles > 0)
+        FoldDispatchStats(queue, stats);
+    while (queue->count == 0 && !queue->stopping)
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->mutex);
+        return false;
+    }
+
+    *job = queue->jobs[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    --queue->count;
+
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+
+    return true;
+}
+
+
+/**
+ Hand a finished response to the connection's writer. Never blocks for long:
+ the ring has room for max_inflight responses and every response corresponds
+ to one inflight job.
+
+ @param conn The connection that sent the puzzle.
+ @param response The response to queue.
+ */
+static void PushResponse(struct ServerConnection *conn, struct ServerResponse const *response) {
+    pthread_mutex_lock(&conn->mutex);
+    conn->responses[(conn->head + conn->count) % conn->max_inflight] = *response;
+    ++conn->count;
+    pthread_cond_broadcast(&conn->changed);
+    pthread_mutex_unlock(&conn->mutex);
+}
+
+
+/**
+ Solve a single job and return the response for it.
+
+ @param job The job.
+ @param scheduler The worker's scheduler, which learns across all jobs it solves.
+ @param store Known solutions, consulted first and extended; NULL for none.
+ @param stats The worker's dispatch stats. Updated.
+ @param response Receives the response.
+ */
+static void SolveJob(struct ServerJob const *job, struct SolveScheduler *scheduler, struct SolutionStore *store,
+                     struct DispatchStats *stats, struct ServerResponse *response) {
+    struct SudokuBoard board;
+
+    response->batch_id = job->batch_id;
+    response->index = job->index;
+
+    if (!BoardFromString(&board, job->puzzle)) {
+        response->status = kServerStatusMalformed;
+        memcpy(response->board, job->puzzle, kBoardChars);
+        return;
+    }
+
+    if (store != NULL && LookupSolution(store, &board, &board)) {
+        response->status = kServerStatusSolved;
+        BoardToString(&board, response->board);
+        return;
+    }
+
+    struct SudokuBoard puzzle = board;
+    bool solved = SolveBoardTiered(&board, scheduler, stats);
+    response->status = solved ? kServerStatusSolved : kServerStatusUnsolved;
+    BoardToString(&board, response->board);
+    if (store != NULL && response->status == kServerStatusSolved)
+        StoreSolution(store, &puzzle, &board);
+}
+
+
+/**
+ Worker thread: take jobs from the shared queue until the server stops.
+
+ @param arg Pointer to struct JobQueue.
+ @return NULL.
+ */
+static void *WorkerMain(void *arg) {
+    struct JobQueue *queue = arg;
+    struct ServerJob job;
+    struct ServerResponse response;
+    struct SolveScheduler scheduler;
+    struct DispatchStats stats;
+
+    InitSolveScheduler(&scheduler);
+    InitDispatchStats(&stats);
+
+    while (PopJob(queue, &job, &stats)) {
+        SolveJob(&job, &scheduler, queue->store, &stats, &response);
+        PushResponse(job.conn, &response);
+        if (stats.puzzles == kStatsFoldJobs) {
+            pthread_mutex_lock(&queue->mutex);
+            FoldDispatchStats(queue, &stats);
+            pthread_mutex_unlock(&queue->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ Read exactly length bytes through the buffered reader.
+
+ @param reader The reader.
+ @param dest Destination buffer.
+ @param length Number of bytes to read.
+ @return true on success; false on end of stream or error.
+ */
+static bool ReadExactly(struct BufferedReader *reader, void *dest, size_t length) {
+    char *out = dest;
+
+    while (length > 0) {
+        if (reader->start == reader->end) {
+            ssize_t got = read(reader->fd, reader->buffer, kReadBufferBytes);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            reader->start = 0;
+            reader->end = (size_t) got;
+        }
+
+        size_t chunk = reader->end - reader->start;
+        if (chunk > length)
+            chunk = length;
+        memcpy(out, reader->buffer + reader->start, chunk);
+        reader->start += chunk;
+        out += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+
+/**
+ Write the whole buffer to the socket.
+
+ @param fd The socket.
+ @param src The bytes to write.
+ @param length Number of bytes.
+ @return true on success; false if the peer went away.
+ */
+static bool WriteExactly(int fd, void const *src, size_t length) {
+    char const *in = src;
+
+    while (length > 0) {
+        ssize_t sent = write(fd, in, length);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        in += sent;
+        length -= (size_t) sent;
+    }
+
+    return true;
+}
+
+
+/**
+ Reserve room in the connection's response ring for one more response,
+ waiting while max_inflight responses are outstanding.
+
+ @param conn The connection.
+ @return false if the peer went away.
+ */
+static bool AcquireInflight(struct ServerConnection *conn) {
+    pthread_mutex_lock(&conn->mutex);
+    while (conn->inflight >= conn->max_inflight && !conn->broken)
+        pthread_cond_wait(&conn->changed, &conn->mutex);
+    bool broken = conn->broken;
+    if (!broken)
+        ++conn->inflight;
+    pthread_mutex_unlock(&conn->mutex);
+
+    return !broken;
+}
+
+
+/**
+ Per-connection reader thread: parse request frames and feed the pool,
+ waiting whenever the connection has max_inflight puzzles outstanding.
+
+ @param arg Pointer to struct ServerConnection.
+ @return NULL.
+ */
+static void *ReaderMain(void *arg) {
+    struct ServerConnection *conn = arg;
+    struct BufferedReader *reader = malloc(sizeof(struct BufferedReader));
+    reader->fd = conn->fd;
+    reader->start = reader->end = 0;
+
+    uint32_t header[2];
+    struct ServerJob job;
+    job.conn = conn;
+
+    while (ReadExactly(reader, header, sizeof header)) {
+        uint32_t length = ntohl(header[0]);
+        if (length < kRequestHeaderBytes || length > kMaxFrameBytes ||
+            (length - kRequestHeaderBytes) % kBoardChars != 0) {
+            struct ServerResponse response;
+            fprintf(stderr, "Closing connection after a request frame of length %u\n", length);
+            response.batch_id = length >= kRequestHeaderBytes ? ntohl(header[1]) : 0;
+            response.index = kServerIndexNone;
+            response.status = kServerStatusBadFrame;
+            memset(response.board, '.', kBoardChars);
+            if (AcquireInflight(conn))
+                PushResponse(conn, &response);
+            break;
+        }
+
+        job.batch_id = ntohl(header[1]);
+        uint32_t num_puzzles = (length - kRequestHeaderBytes) / kBoardChars;
+        bool ok = true;
+
+        for (job.index = 0; job.index < num_puzzles; ++job.index) {
+            if (!ReadExactly(reader, job.puzzle, kBoardChars)) {
+                ok = false;
+                break;
+            }
+
+            if (!AcquireInflight(conn)) {
+                ok = false;
+                break;
+            }
+            PushJob(conn->queue, &job);
+        }
+
+        if (!ok)
+            break;
+    }
+
+    free(reader);
+
+    pthread_mutex_lock(&conn->mutex);
+    conn->reader_done = true;
+    pthread_cond_broadcast(&conn->changed);
+    pthread_mutex_unlock(&conn->mutex);
+
+    return NULL;
+}
+
+
+/**
+ Per-connection writer thread: stream responses back as they are produced.
+ Owns the connection and frees it once the reader is done and every inflight
+ job has been answered.
+
+ @param arg Pointer to struct ServerConnection.
+ @return NULL.
+ */
+static void *WriterMain(void *arg) {
+    struct ServerConnection *conn = arg;
+    unsigned char frames[kWriteBatch][4 + kResponseBodyBytes];
+
+    pthread_mutex_lock(&conn->mutex);
+    while (true) {
+        while (conn->count == 0 && !(conn->reader_done && conn->inflight == 0))
+            pthread_cond_wait(&conn->changed, &conn->mutex);
+
+        if (conn->count == 0)
+            break;
+
+        int num_frames = 0;
+        while (conn->count > 0 && num_frames < kWriteBatch) {
+            struct ServerResponse *response = &conn->responses[conn->head];
+            unsigned char *frame = frames[num_frames++];
+            uint32_t words[3] = {htonl(kResponseBodyBytes), htonl(response->batch_id), htonl(response->index)};
+
+            memcpy(frame, words, sizeof words);
+            frame[sizeof words] = response->status;
+            memcpy(frame + sizeof words + 1, response->board, kBoardChars);
+
+            conn->head = (conn->head + 1) % conn->max_inflight;
+            --conn->count;
+        }
+        bool broken = conn->broken;
+        pthread_mutex_unlock(&conn->mutex);
+
+        if (!broken && !WriteExactly(conn->fd, frames, num_frames * sizeof frames[0])) {
+            // Wake the reader if it is blocked in read() and stop accepting work.
+            shutdown(conn->fd, SHUT_RDWR);
+            broken = true;
+        }
+
+        pthread_mutex_lock(&conn->mutex);
+        conn->broken = conn->broken || broken;
+        conn->inflight -= num_frames;
+        pthread_cond_broadcast(&conn->changed);
+    }
+    pthread_mutex_unlock(&conn->mutex);
+
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->mutex);
+    pthread_cond_destroy(&conn->changed);
+    free(conn->responses);
+    free(conn);
+
+    return NULL;
+}
+
+
+/**
+ Return the default server options: one worker per online processor and no
+ solution store.
+
+ @return struct ServerOptions.
+ */
+struct ServerOptions DefaultServerOptions() {
+    struct ServerOptions options;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    options.num_workers = num_cpus > 0 ? (int) num_cpus : 1;
+    options.max_inflight = 256;
+    options.job_queue_capacity = 4096;
+    options.store = NULL;
+
+    return options;
+}
+
+
+/**
+ Start a detached thread.
+
+ @param start_routine Thread entry point.
+ @param arg Argument to the entry point.
+ @return true on success.
+ */
+static bool StartDetached(void *(*start_routine)(void *), void *arg) {
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, start_routine, arg) != 0)
+        return false;
+    pthread_detach(thread);
+
+    return true;
+}
+
+
+/**
+ Signal handler for SIGINT and SIGTERM: make the accept loop of RunServer()
+ fail. shutdown() is async-signal-safe and, unlike setting a flag, cannot be
+ missed by a thread that is just about to block in accept().
+
+ @param signal_number The signal.
+ */
+static void StopServer(int signal_number) {
+    (void) signal_number;
+    if (listen_socket >= 0)
+        shutdown(listen_socket, SHUT_RDWR);
+}
+
+
+/**
+ Listen on the Unix domain socket at socket_path and serve solve requests
+ until SIGINT or SIGTERM. Any existing file at socket_path is removed.
+
+ @param socket_path File system path of the socket.
+ @param options Pool and backpressure settings, and the solution store if any.
+ @return 0 after a signal stopped the server; non-zero on failure to set up
+ the socket or the worker pool, or if accepting connections failed.
+ */
+int RunServer(char const *socket_path, struct ServerOptions const *options) {
+    struct sockaddr_un address;
+    struct sigaction stop_action, old_int_action, old_term_action;
+
+    if (strlen(socket_path) >= sizeof address.sun_path) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr *) &address, sizeof address) != 0 || listen(listen_fd, 64) != 0) {
+        perror(socket_path);
+        close(listen_fd);
+        return 1;
+    }
+
+    struct JobQueue *queue = malloc(sizeof(struct JobQueue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->capacity = options->job_queue_capacity;
+    queue->jobs = malloc(queue->capacity * sizeof(struct ServerJob));
+    queue->head = 0;
+    queue->count = 0;
+    queue->store = options->store;
+    InitDispatchStats(&queue->stats);
+    queue->stopping = false;
+
+    pthread_t *workers = malloc(options->num_workers * sizeof(pthread_t));
+    for (int worker = 0; worker < options->num_workers; ++worker) {
+        if (pthread_create(&workers[worker], NULL, WorkerMain, queue) != 0) {
+            fprintf(stderr, "Could not start worker %d\n", worker);
+            return 1;
+        }
+    }
+
+    listen_socket = listen_fd;
+    memset(&stop_action, 0, sizeof stop_action);
+    stop_action.sa_handler = StopServer;
+    sigemptyset(&stop_action.sa_mask);
+    sigaction(SIGINT, &stop_action, &old_int_action);
+    sigaction(SIGTERM, &stop_action, &old_term_action);
+
+    fprintf(stderr, "Serving on %s with %d workers\n", socket_path, options->num_workers);
+
+    int result = 0;
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EINVAL) {  // EINVAL: StopServer() shut the socket down
+                perror("accept");
+                result = 1;
+            }
+            break;
+        }
+
+        struct ServerConnection *conn = malloc(sizeof(struct ServerConnection));
+        conn->fd = fd;
+        conn->max_inflight = options->max_inflight;
+        pthread_mutex_init(&conn->mutex, NULL);
+        pthread_cond_init(&conn->changed, NULL);
+        conn->responses = malloc(conn->max_inflight * sizeof(struct ServerResponse));
+        conn->head = 0;
+        conn->count = 0;
+        conn->inflight = 0;
+        conn->reader_done = false;
+        conn->broken = false;
+        conn->queue = queue;
+
+        if (!StartDetached(ReaderMain, conn)) {
+            fprintf(stderr, "Could not start reader thread\n");
+            close(fd);
+            pthread_mutex_destroy(&conn->mutex);
+            pthread_cond_destroy(&conn->changed);
+            free(conn->responses);
+            free(conn);
+            continue;
+        }
+        if (!StartDetached(WriterMain, conn)) {
+            // Without a writer the reader and workers may still reference the
+            // connection, so it is deliberately leaked rather than freed.
+            fprintf(stderr, "Could not start writer thread\n");
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    sigaction(SIGINT, &old_int_action, NULL);
+    sigaction(SIGTERM, &old_term_action, NULL);
+    listen_socket = -1;
+    close(listen_fd);
+    unlink(socket_path);
+
+    // Let the workers drain the queue; each folds its stats as it exits.
+    pthread_mutex_lock(&queue->mutex);
+    queue->stopping = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+    for (int worker = 0; worker < options->num_workers; ++worker)
+        pthread_join(workers[worker], NULL);
+    free(workers);
+
+    fprintf(stderr, "%ld puzzles solved by tier:\n", queue->stats.puzzles);
+    PrintDispatchStats(&queue->stats, stderr);
+
+    // Readers and writers of connections still open may refer to the queue.
+    return result;
+}
@@ -0,0 +1,49 @@
+//
+//  server.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef server_h
+#define server_h
+
+#include <stdint.h>
+
+struct SolutionStore;
+
+/**
+ Wire format (all integers are unsigned 32 bit in network byte order).
+
+ Request frame:  length | batch_id | puzzle_0 | puzzle_1 | ...
+ Response frame: length | batch_id | index | status (1 byte) | board
+
+ length counts the bytes following it. Each puzzle and board is
+ kMaxNumber * kMaxNumber characters in the format of BoardFromString().
+ Responses are sent as soon as each puzzle is done, so they may arrive out
+ of order; index is the position of the puzzle within its batch.
+
+ A request frame whose length is not 4 plus a multiple of the board size, or
+ exceeds 16 MiB, is answered with one response of status
+ kServerStatusBadFrame, index kServerIndexNone and a board of '.', after
+ which the server closes the connection.
+ */
+
+extern const uint8_t kServerStatusSolved;
+extern const uint8_t kServerStatusUnsolved;
+extern const uint8_t kServerStatusMalformed;
+extern const uint8_t kServerStatusBadFrame;
+extern const uint32_t kServerIndexNone;
+
+struct ServerOptions {
+    int num_workers;         // size of the solver pool
+    int max_inflight;        // puzzles per connection read but not yet answered
+    int job_queue_capacity;  // puzzles waiting for a worker across all connections
+    struct SolutionStore *store; // known solutions, consulted and extended; NULL for none
+};
+
+struct ServerOptions DefaultServerOptions();
+int RunServer(char const *socket_path, struct ServerOptions const *options);
+
+#endif /* server_h */
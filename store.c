@@ -0,0 +1,306 @@
+//
+//  store.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#define _POSIX_C_SOURCE 200809L   // pread(), pwrite(), ftruncate()
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "engine.h"
+#include "store.h"
+
+/*
+ A file of solved puzzles shared by every process that opens it.
+
+ The file is an open-addressing hash table of fixed size: a header followed by
+ 2^log2_slots slots. A slot holds the puzzle's clues and its solution, each
+ packed four bits per cell, and a tag derived from the hash of the clues. The
+ whole file is mapped shared, so a lookup reads the page cache directly, with
+ no system call and no copy beyond the packed solution it returns.
+
+ Slots are written once and never changed. A writer fills in the clues and the
+ solution of an empty slot and only then stores its tag with release ordering;
+ a reader loads the tag with acquire ordering, so a slot whose tag it sees is
+ complete. Lookups therefore take no lock. Writers exclude each other with
+ flock() on the file across processes and with a mutex within the process
+ (flock() does not separate threads sharing one descriptor), and look again
+ under the lock so that a puzzle is stored only once.
+
+ A tag of zero marks an empty slot, which ends a probe sequence. The table does
+ not grow: once probing runs too long the store is full and further solutions
+ are not kept, which costs only the benefit of the cache.
+
+ The store is for processes on one host. Both the shared mapping and flock()
+ rely on the local page cache: on NFS or another network file system, clients
+ on different machines neither see each other's writes through the mapping nor
+ exclude each other reliably. Since the file is not trusted either, a solution
+ is returned only if it unpacks to a complete, valid grid that agrees with
+ every clue of the puzzle asked about.
+ */
+
+#define kPackedBytes 41            // (kMaxNumber * kMaxNumber + 1) / 2
+
+static const char kStoreMagic[8] = {'S', 'D', 'K', 'S', 'T', 'O', 'R', 'E'};
+static const uint32_t kStoreVersion = 1;
+static const int kMaxProbes = 32;
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t log2_slots;
+    uint32_t slot_size;
+    uint8_t reserved[44];          // keeps the slots 64-byte aligned
+};
+
+struct StoreSlot {
+    _Atomic uint64_t tag;          // 0 while empty
+    uint8_t clues[kPackedBytes];   // 0 for an open cell
+    uint8_t solution[kPackedBytes];
+    uint8_t reserved[6];
+};
+
+struct SolutionStore {
+    int fd;
+    bool writable;
+    void *map;
+    size_t map_size;
+    struct StoreSlot *slots;
+    uint64_t mask;                 // number of slots - 1
+    pthread_mutex_t write_mutex;
+};
+
+
+/**
+ Pack the values of the solved cells of a board four bits per cell, 0 for
+ cells that are not solved.
+
+ @param board_ptr The board.
+ @param packed Receives kPackedBytes bytes.
+ */
+static void PackBoard(struct SudokuBoard const *board_ptr, uint8_t packed[kPackedBytes]) {
+    memset(packed, 0, kPackedBytes);
+
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int value = SinglePossible(board_ptr->cells[cell / kMaxNumber][cell % kMaxNumber]);
+        if (value > 0)
+            packed[cell / 2] |= (uint8_t) (value << (4 * (cell % 2)));
+    }
+}
+
+
+/**
+ Overwrite a board with a packed grid.
+
+ @param packed kPackedBytes bytes as written by PackBoard().
+ @param board_ptr The board. Will be overwritten.
+ @return false if some cell holds a value above kMaxNumber.
+ */
+static bool UnpackBoard(uint8_t const packed[kPackedBytes], struct SudokuBoard *board_ptr) {
+    ClearBoard(board_ptr);
+
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int value = (packed[cell / 2] >> (4 * (cell % 2))) & 0xf;
+        if (value > kMaxNumber)
+            return false;
+        if (value != 0)
+            SetCell(board_ptr, cell / kMaxNumber, cell % kMaxNumber, (unsigned int) value);
+    }
+    return true;
+}
+
+
+/**
+ Return the tag of a packed puzzle: its 64-bit FNV-1a hash, never 0.
+
+ @param packed kPackedBytes bytes.
+ @return The tag.
+ */
+static uint64_t PackedTag(uint8_t const packed[kPackedBytes]) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int index = 0; index < kPackedBytes; ++index) {
+        hash ^= packed[index];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash != 0 ? hash : 1;
+}
+
+
+/**
+ Probe for a puzzle.
+
+ @param store The store.
+ @param clues The packed puzzle.
+ @param tag Its tag.
+ @return The slot holding the puzzle, the empty slot where it would go, or NULL
+    if neither was found within kMaxProbes slots.
+ */
+static struct StoreSlot *FindSlot(struct SolutionStore const *store, uint8_t const clues[kPackedBytes],
+                                  uint64_t tag) {
+    for (int probe = 0; probe < kMaxProbes; ++probe) {
+        struct StoreSlot *slot = &store->slots[(tag + (uint64_t) probe) & store->mask];
+        uint64_t slot_tag = atomic_load_explicit(&slot->tag, memory_order_acquire);
+
+        if (slot_tag == 0 || (slot_tag == tag && memcmp(slot->clues, clues, kPackedBytes) == 0))
+            return slot;
+    }
+
+    return NULL;
+}
+
+
+/**
+ Open a store, creating the file if it does not exist yet. If the file cannot
+ be opened for writing it is opened for lookups only.
+
+ @param path The file.
+ @param log2_slots Size of a new file: 2^log2_slots slots of 96 bytes. Ignored
+    if the file exists.
+ @return The store, or NULL if the file could not be opened or is not a store.
+ */
+struct SolutionStore *OpenSolutionStore(char const *path, int log2_slots) {
+    struct SolutionStore *store = malloc(sizeof(struct SolutionStore));
+    struct StoreHeader header;
+    struct stat status;
+
+    store->writable = true;
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0) {
+        store->writable = false;
+        store->fd = open(path, O_RDONLY);
+    }
+    if (store->fd < 0) {
+        free(store);
+        return NULL;
+    }
+
+    // Initialize a new file under the lock, so that two processes creating
+    // it at once do not both write the header.
+    bool ok = flock(store->fd, store->writable ? LOCK_EX : LOCK_SH) == 0 && fstat(store->fd, &status) == 0;
+    if (ok && status.st_size == 0 && store->writable) {
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, kStoreMagic, sizeof header.magic);
+        header.version = kStoreVersion;
+        header.log2_slots = (uint32_t) log2_slots;
+        header.slot_size = sizeof(struct StoreSlot);
+        status.st_size = (off_t) (sizeof header + ((size_t) 1 << log2_slots) * sizeof(struct StoreSlot));
+        ok = ftruncate(store->fd, status.st_size) == 0 && pwrite(store->fd, &header, sizeof header, 0) == sizeof header;
+    }
+    ok = ok && pread(store->fd, &header, sizeof header, 0) == sizeof header &&
+        memcmp(header.magic, kStoreMagic, sizeof kStoreMagic) == 0 && header.version == kStoreVersion &&
+        header.slot_size == sizeof(struct StoreSlot) && header.log2_slots < 48 &&
+        (size_t) status.st_size == sizeof header + ((size_t) 1 << header.log2_slots) * sizeof(struct StoreSlot);
+    flock(store->fd, LOCK_UN);
+
+    if (ok) {
+        store->map_size = (size_t) status.st_size;
+        store->map = mmap(NULL, store->map_size, store->writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                          store->fd, 0);
+        ok = store->map != MAP_FAILED;
+    }
+    if (!ok) {
+        close(store->fd);
+        free(store);
+        return NULL;
+    }
+
+    store->slots = (struct StoreSlot *) ((char *) store->map + sizeof header);
+    store->mask = ((uint64_t) 1 << header.log2_slots) - 1;
+    pthread_mutex_init(&store->write_mutex, NULL);
+
+    return store;
+}
+
+
+/**
+ Close a store. Solutions stored are already in the file.
+
+ @param store The store. No thread may be using it.
+ */
+void CloseSolutionStore(struct SolutionStore *store) {
+    munmap(store->map, store->map_size);
+    close(store->fd);
+    pthread_mutex_destroy(&store->write_mutex);
+    free(store);
+}
+
+
+/**
+ Look up the solution of a puzzle. Safe to call from any number of threads and
+ processes while others store solutions.
+
+ @param store The store.
+ @param puzzle The puzzle: its solved cells are the clues.
+ @param solution Receives the solution if it is known. May be the same board as puzzle.
+ @return true if the solution was known, is a valid grid and keeps the clues.
+ */
+bool LookupSolution(struct SolutionStore const *store, struct SudokuBoard const *puzzle,
+                    struct SudokuBoard *solution) {
+    uint8_t clues[kPackedBytes];
+    struct SudokuBoard found;
+
+    PackBoard(puzzle, clues);
+    struct StoreSlot *slot = FindSlot(store, clues, PackedTag(clues));
+    if (slot == NULL || atomic_load_explicit(&slot->tag, memory_order_relaxed) == 0)
+        return false;
+    if (!UnpackBoard(slot->solution, &found) || !IsBoardSolved(&found) || IsBoardContradictory(&found))
+        return false;
+    for (int cell = 0; cell < kMaxNumber * kMaxNumber; ++cell) {
+        int clue = (clues[cell / 2] >> (4 * (cell % 2))) & 0xf;
+        if (clue != 0 && clue != SinglePossible(found.cells[cell / kMaxNumber][cell % kMaxNumber]))
+            return false;
+    }
+
+    found.trail = solution->trail;
+    *solution = found;
+    return true;
+}
+
+
+/**
+ Add the solution of a puzzle to the store, unless it is already there.
+
+ @param store The store.
+ @param puzzle The puzzle: its solved cells are the clues.
+ @param solution The solved board.
+ @return false if the store is read-only, full around the puzzle's slot, or the lock failed.
+ */
+bool StoreSolution(struct SolutionStore *store, struct SudokuBoard const *puzzle,
+                   struct SudokuBoard const *solution) {
+    uint8_t clues[kPackedBytes];
+
+    if (!store->writable)
+        return false;
+
+    PackBoard(puzzle, clues);
+    uint64_t tag = PackedTag(clues);
+
+    pthread_mutex_lock(&store->write_mutex);
+    bool ok = flock(store->fd, LOCK_EX) == 0;
+    struct StoreSlot *slot = ok ? FindSlot(store, clues, tag) : NULL;
+
+    if (slot != NULL && atomic_load_explicit(&slot->tag, memory_order_relaxed) == 0) {
+        memcpy(slot->clues, clues, kPackedBytes);
+        PackBoard(solution, slot->solution);
+        atomic_store_explicit(&slot->tag, tag, memory_order_release);
+    }
+
+    if (ok)
+        flock(store->fd, LOCK_UN);
+    pthread_mutex_unlock(&store->write_mutex);
+
+    return slot != NULL;
+}
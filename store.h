@@ -0,0 +1,24 @@
+//
+//  store.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef store_h
+#define store_h
+
+#include <stdbool.h>
+#include "engine.h"
+
+struct SolutionStore;
+
+struct SolutionStore *OpenSolutionStore(char const *path, int log2_slots);
+void CloseSolutionStore(struct SolutionStore *store);
+bool LookupSolution(struct SolutionStore const *store, struct SudokuBoard const *puzzle,
+                    struct SudokuBoard *solution);
+bool StoreSolution(struct SolutionStore *store, struct SudokuBoard const *puzzle,
+                   struct SudokuBoard const *solution);
+
+#endif /* store_h */
@@ -6,11 +6,36 @@
 //  Copyright © 2016 Rolf. All rights reserved.
 //
 
+#define _POSIX_C_SOURCE 200809L   // mkstemp(), nanosleep()
+
 #include "tests.h"
+#include "dispatch.h"
+#include "edit.h"
 #include "engine.h"
+#include "examples.h"
+#include "hint.h"
+#include "layout.h"
+#include "loadgen.h"
+#include "pipeline.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "search.h"
+#include "server.h"
+#include "store.h"
+#include "trace.h"
+#include "validate.h"
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 
 /*
  Regression tests for the Sudoku solver.
@@ -31,6 +56,25 @@ void TestAll() {
     TestFindLineClusters();
     TestFindLineClusters2();
     TestFindLineClusters3();
+    TestFindLineClustersQuad();
+    TestFindLineClustersHidden();
+    TestBoardStringRoundTrip();
+    TestSolveBoardScheduled();
+    TestSearchBoard();
+    TestNextHint();
+    TestHiddenHint();
+    TestEditableBoard();
+    TestTrailCheckpoints();
+    TestBoundedQueue();
+    TestPipeline();
+    TestValidateGrids();
+    TestVariantLayouts();
+    TestTraceRing();
+    TestSolutionStore();
+    TestSolveBoardTiered();
+    TestLatencyHistogram();
+    TestRunLoad();
+    TestServer();
     printf("Testing done.\n\n");
 }
 
@@ -248,6 +292,66 @@ void TestFindLineClusters3() {
 
 
 
+/**
+ Test that FindLineClusters finds clusters larger than three cells.
+ */
+void TestFindLineClustersQuad() {
+    PrintTestHeader("FindLineClusters (quad)");
+    
+    struct SudokuCell cells[kMaxNumber];
+    
+    // Assume kMaxNumber >= 9
+    for (int index = 0; index < kMaxNumber; ++index)
+        cells[index].possibles = kAllBits;
+    cells[0].possibles = 3;  // 1 and 2
+    cells[3].possibles = 6;  // 2 and 3
+    cells[5].possibles = 12; // 3 and 4
+    cells[8].possibles = 9;  // 1 and 4
+    
+    struct LineClusterGroups groups = FindLineClusters(cells);
+    
+    AssertIntEqual(groups.size, 1, "Incorrect number of cluster groups");
+    AssertIntEqual(groups.clusters[0].size, 4, "Incorrect cluster size");
+    AssertIntEqual(groups.clusters[0].bitset, 15, "Incorrect cluster value bitset");
+    AssertIntEqual(groups.clusters[0].positions[0], 0, "Wrong 4-cluster position");
+    AssertIntEqual(groups.clusters[0].positions[3], 8, "Wrong 4-cluster position");
+    
+    FreeLineClusterGroups(&groups);
+}
+
+
+/**
+ Test that a hidden subset (values confined to as many cells, which may also
+ hold other values) is found through its complementary cluster, and that
+ filtering by it reduces the hidden cells.
+ */
+void TestFindLineClustersHidden() {
+    PrintTestHeader("FindLineClusters (hidden)");
+    
+    struct SudokuCell cells[kMaxNumber];
+    int hidden_bits = (1 << (3 - 1)) | (1 << (7 - 1)); // 3 and 7
+    
+    // Assume kMaxNumber >= 9
+    for (int index = 0; index < kMaxNumber; ++index)
+        cells[index].possibles = kAllBits ^ hidden_bits;
+    cells[2].possibles = kAllBits;
+    cells[6].possibles = kAllBits;
+    
+    struct LineClusterGroups groups = FindLineClusters(cells);
+    
+    AssertIntEqual(groups.size, 1, "Incorrect number of cluster groups");
+    AssertIntEqual(groups.clusters[0].size, kMaxNumber - 2, "Incorrect cluster size");
+    AssertIntEqual(groups.clusters[0].bitset, kAllBits ^ hidden_bits, "Incorrect cluster value bitset");
+    
+    FilterCellsByClusters(cells, &groups);
+    AssertIntEqual(cells[2].possibles, hidden_bits, "Hidden pair not reduced");
+    AssertIntEqual(cells[6].possibles, hidden_bits, "Hidden pair not reduced");
+    AssertIntEqual(cells[0].possibles, kAllBits ^ hidden_bits, "Cell outside hidden pair changed");
+    
+    FreeLineClusterGroups(&groups);
+}
+
+
 /**
  Test the function BitCount.
  */
@@ -313,3 +417,1108 @@ void TestFilterCellsByClusters() {
         AssertIntEqual(cells[cell_index].possibles, expected[cell_index].possibles, err_msg);
     }
 }
+
+
+/**
+ Test that BoardFromString() and BoardToString() are inverses and that
+ malformed text is rejected.
+ */
+void TestBoardStringRoundTrip() {
+    PrintTestHeader("BoardFromString / BoardToString");
+    
+    char const *puzzle =
+        "..5.7.8.." "..4...1.." "8.7....96"
+        "...1...28" "...2..9.." "4..95..1."
+        "....39.51" "3568.2..." ".1.......";
+    char text[81];
+    struct SudokuBoard board;
+    
+    AssertIntEqual(BoardFromString(&board, puzzle), true, "Valid puzzle rejected");
+    AssertIntEqual(SinglePossible(board.cells[0][2]), 5, "Wrong clue parsed");
+    AssertIntEqual(board.cells[0][0].possibles, kAllBits, "Blank cell not blank");
+    
+    BoardToString(&board, text);
+    for (int index = 0; index < 81; ++index)
+        AssertIntEqual(text[index], puzzle[index], "Round trip changed the board");
+    
+    AssertIntEqual(IsBoardSolved(&board), false, "Puzzle reported solved");
+    SolveBoard(&board);
+    AssertIntEqual(IsBoardSolved(&board), true, "Example not solved");
+    
+    text[40] = 'x';
+    AssertIntEqual(BoardFromString(&board, text), false, "Malformed puzzle accepted");
+}
+
+
+/**
+ Test that SolveBoardScheduled() reaches the same board as SolveBoard(), also
+ when the scheduler has already learnt from an earlier solve.
+ */
+void TestSolveBoardScheduled() {
+    PrintTestHeader("SolveBoardScheduled");
+    
+    struct SolveScheduler scheduler;
+    InitSolveScheduler(&scheduler);
+    
+    struct SudokuBoard *expected_ptr = example1();
+    SolveBoard(expected_ptr);
+    
+    for (int round = 0; round < 2; ++round) {
+        struct SudokuBoard *board_ptr = example1();
+        SolveBoardScheduled(board_ptr, &scheduler);
+        
+        for (int row = 0; row < 9; ++row)
+            for (int col = 0; col < 9; ++col)
+                AssertIntEqual(board_ptr->cells[row][col].possibles, expected_ptr->cells[row][col].possibles,
+                               "Scheduled solve differs from SolveBoard()");
+        free(board_ptr);
+    }
+    
+    long eliminations = 0;
+    for (int technique = 0; technique < kNumTechniques; ++technique)
+        eliminations += scheduler.stats[technique].eliminations;
+    AssertIntEqual(scheduler.stats[kTechniqueRowSingles].calls > 0, true, "Cheap technique never run");
+    AssertIntEqual((int) eliminations, 2 * (81 * 9 - 81 - 28 * 8), "Wrong elimination count");
+    
+    free(expected_ptr);
+}
+
+
+/**
+ Test SearchBoard() on a puzzle that needs search, on a blank board (many
+ solutions) and on a contradictory board, both with one and several threads.
+ */
+void TestSearchBoard() {
+    PrintTestHeader("SearchBoard");
+    
+    char const *hard_puzzle =
+        "8........" "..36....." ".7..9.2.."
+        ".5...7..." "....457.." "...1...3."
+        "..1....68" "..85...1." ".9....4..";
+    char const *hard_solution =
+        "812753649" "943682175" "675491283"
+        "154237896" "369845721" "287169534"
+        "521974368" "438526917" "796318452";
+    char text[81];
+    struct SudokuBoard board;
+    struct SearchOptions options = DefaultSearchOptions();
+    options.max_solutions = 2;
+    
+    for (int num_threads = 1; num_threads <= 4; num_threads += 3) {
+        options.num_threads = num_threads;
+        
+        BoardFromString(&board, hard_puzzle);
+        AssertIntEqual(SearchBoard(&board, &options).num_solutions, 1, "Hard puzzle should be unique");
+        BoardToString(&board, text);
+        for (int index = 0; index < 81; ++index)
+            AssertIntEqual(text[index], hard_solution[index], "Wrong solution to hard puzzle");
+        
+        struct SudokuBoard *blank_ptr = blank_board();
+        AssertIntEqual(SearchBoard(blank_ptr, &options).num_solutions, 2, "Blank board has many solutions");
+        AssertIntEqual(IsBoardSolved(blank_ptr) && !IsBoardContradictory(blank_ptr), true,
+                       "Blank board not filled with a solution");
+        free(blank_ptr);
+        
+        BoardFromString(&board, hard_puzzle);
+        SetCell(&board, 0, 8, 8); // 8 twice on the first row
+        AssertIntEqual(SearchBoard(&board, &options).num_solutions, 0, "Contradictory board solved");
+    }
+}
+
+
+/**
+ Test that following the hints one at a time ends in the same board as
+ SolveBoard(), and that every hint makes progress within its unit.
+ */
+void TestNextHint() {
+    PrintTestHeader("NextHint");
+    
+    struct SudokuBoard *expected_ptr = example1();
+    SolveBoard(expected_ptr);
+    
+    struct SudokuBoard *board_ptr = example1();
+    struct HintState state;
+    struct Hint hint;
+    int num_hints = 0;
+    
+    InitHintState(&state, board_ptr);
+    while (NextHint(&state, &hint)) {
+        ++num_hints;
+        AssertIntEqual(hint.num_eliminations > 0, true, "Hint without eliminations");
+        AssertIntEqual(BitCount(hint.cluster_bits), hint.cluster_size, "Cluster size does not match its values");
+        for (int index = 0; index < hint.num_eliminations; ++index) {
+            int cell = hint.eliminated_cells[index];
+            AssertIntEqual(state.board.cells[cell / 9][cell % 9].possibles & hint.eliminated_bits[index], 0,
+                           "Hint was not applied");
+        }
+    }
+    
+    AssertIntEqual(num_hints > 0, true, "No hints for example");
+    for (int row = 0; row < 9; ++row)
+        for (int col = 0; col < 9; ++col)
+            AssertIntEqual(state.board.cells[row][col].possibles, expected_ptr->cells[row][col].possibles,
+                           "Hints end in a different board than SolveBoard()");
+    
+    free(board_ptr);
+    free(expected_ptr);
+}
+
+
+/**
+ Test that a hidden single is explained as such, as --hints prints it: the
+ value and the one cell it fits, not the complementary cluster of the other
+ open cells of the unit.
+ */
+void TestHiddenHint() {
+    PrintTestHeader("Hidden single hint");
+    
+    char const *puzzle = "..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1.......";
+    char line[256] = "";
+    struct SudokuBoard board;
+    struct HintState state;
+    struct Hint hint;
+    
+    BoardFromString(&board, puzzle);
+    InitHintState(&state, &board);
+    bool found = false;
+    while (!found && NextHint(&state, &hint))
+        found = hint.technique != kHintSingle;
+    
+    // Row 8 (r8c5 is the only cell left for a 1) once the singles have run out.
+    AssertIntEqual(found, true, "No hint beyond singles");
+    AssertIntEqual(hint.technique, kHintHidden, "First hint beyond singles not hidden");
+    AssertIntEqual(hint.cluster_size, 1, "Hidden single size");
+    AssertIntEqual(hint.cluster_bits, 1 << (1 - 1), "Hidden single value");
+    AssertIntEqual(hint.cluster_cells[0], 7 * 9 + 4, "Hidden single cell");
+    AssertIntEqual(hint.num_eliminations, 1, "Hidden single eliminations");
+    AssertIntEqual(state.board.cells[7][4].possibles, 1 << (1 - 1), "Hidden single not applied");
+    
+    FILE *stream = tmpfile();
+    PrintHint(&hint, stream);
+    rewind(stream);
+    fgets(line, sizeof line, stream);
+    fclose(stream);
+    AssertIntEqual(strcmp(line, "Hidden in row 8: values 1 only fit r8c5 rule out r8c5:4\n"), 0,
+                   "Hidden single printed wrongly");
+}
+
+
+/**
+ Assert that an edited board matches a from-scratch SolveBoard() of the same clues.
+
+ @param edit_ptr The board under edit.
+ @param error_message The string to print when the assertion fails.
+ */
+void AssertEditMatchesSolve(struct EditableBoard const *edit_ptr, char *error_message) {
+    struct SudokuBoard *board_ptr = blank_board();
+    
+    for (int cell = 0; cell < 81; ++cell)
+        if (edit_ptr->clues[cell] != 0)
+            SetCell(board_ptr, cell / 9, cell % 9, edit_ptr->clues[cell]);
+    SolveBoard(board_ptr);
+    
+    for (int row = 0; row < 9; ++row)
+        for (int col = 0; col < 9; ++col)
+            AssertIntEqual(edit_ptr->board.cells[row][col].possibles, board_ptr->cells[row][col].possibles,
+                           error_message);
+    
+    free(board_ptr);
+}
+
+
+/**
+ Return the number of units examined to build the current clues of an edited
+ board from scratch, one EditSetClue() per clue.
+
+ @param edit_ptr The board under edit.
+ @return Units examined by the rebuild.
+ */
+long RebuildUnitsExamined(struct EditableBoard const *edit_ptr) {
+    struct EditableBoard *rebuild_ptr = malloc(sizeof(struct EditableBoard));
+
+    InitEditableBoard(rebuild_ptr);
+    for (int cell = 0; cell < 81; ++cell)
+        if (edit_ptr->clues[cell] != 0)
+            EditSetClue(rebuild_ptr, cell / 9, cell % 9, (unsigned int) edit_ptr->clues[cell]);
+
+    long units_examined = rebuild_ptr->units_examined;
+    free(rebuild_ptr);
+    return units_examined;
+}
+
+
+/**
+ Test that setting and clearing clues one at a time keeps the board equal to
+ solving the current clues from scratch, and that an edit examines a small
+ part of the units that rebuilding the board from its clues does.
+ */
+void TestEditableBoard() {
+    PrintTestHeader("EditableBoard");
+    
+    struct SudokuBoard *example_ptr = example1();
+    struct EditableBoard *edit_ptr = malloc(sizeof(struct EditableBoard));
+    char text[81];
+    
+    BoardToString(example_ptr, text);
+    InitEditableBoard(edit_ptr);
+    for (int cell = 0; cell < 81; ++cell)
+        if (text[cell] != '.')
+            EditSetClue(edit_ptr, cell / 9, cell % 9, text[cell] - '0');
+    AssertEditMatchesSolve(edit_ptr, "Wrong board after setting clues");
+    AssertIntEqual(IsBoardSolved(&edit_ptr->board), true, "Example not solved by edits");
+    
+    // Remove two clues, add one elsewhere (consistent with the solution), then restore.
+    EditClearClue(edit_ptr, 0, 2);
+    AssertEditMatchesSolve(edit_ptr, "Wrong board after clearing a clue");
+    
+    EditClearClue(edit_ptr, 4, 3);
+    AssertEditMatchesSolve(edit_ptr, "Wrong board after clearing a second clue");
+    
+    EditSetClue(edit_ptr, 0, 0, 1);
+    AssertEditMatchesSolve(edit_ptr, "Wrong board after adding a clue");
+    
+    // Each restoring edit must examine under a quarter of the units a rebuild
+    // does. Setting a clue here must also examine fewer than the 27 units that
+    // any solve from scratch examines at least once.
+    int restore_cells[3][2] = {{0, 0}, {4, 3}, {0, 2}};
+    unsigned int restore_values[3] = {0, 2, 5};
+    for (int index = 0; index < 3; ++index) {
+        long units_before = edit_ptr->units_examined;
+        if (restore_values[index] == 0)
+            EditClearClue(edit_ptr, restore_cells[index][0], restore_cells[index][1]);
+        else
+            EditSetClue(edit_ptr, restore_cells[index][0], restore_cells[index][1], restore_values[index]);
+        long units_edit = edit_ptr->units_examined - units_before;
+        AssertIntEqual(units_edit > 0 && 4 * units_edit < RebuildUnitsExamined(edit_ptr), true,
+                       "Edit not incremental");
+        if (restore_values[index] != 0)
+            AssertIntEqual(units_edit < 3 * kMaxNumber, true, "Setting a clue examined every unit");
+    }
+    AssertEditMatchesSolve(edit_ptr, "Wrong board after restoring the clues");
+    
+    free(edit_ptr);
+    free(example_ptr);
+}
+
+
+/**
+ Test that restoring a checkpoint undoes exactly the changes made since,
+ including those made by SolveBoard().
+ */
+void TestTrailCheckpoints() {
+    PrintTestHeader("Trail checkpoints");
+    
+    struct SudokuBoard *board_ptr = example1();
+    struct SudokuBoard original = *board_ptr;
+    struct Trail trail;
+    
+    InitTrail(&trail);
+    board_ptr->trail = &trail;
+    
+    int outer = MarkCheckpoint(board_ptr);
+    SetCell(board_ptr, 0, 0, 1);
+    struct SudokuBoard after_set = *board_ptr;
+    AssertIntEqual(trail.size, 1, "SetCell not recorded once");
+    
+    int inner = MarkCheckpoint(board_ptr);
+    SolveBoard(board_ptr);
+    AssertIntEqual(IsBoardSolved(board_ptr), true, "Example not solved");
+    
+    RestoreCheckpoint(board_ptr, inner);
+    for (int row = 0; row < 9; ++row)
+        for (int col = 0; col < 9; ++col)
+            AssertIntEqual(board_ptr->cells[row][col].possibles, after_set.cells[row][col].possibles,
+                           "Inner checkpoint not restored");
+    
+    RestoreCheckpoint(board_ptr, outer);
+    for (int row = 0; row < 9; ++row)
+        for (int col = 0; col < 9; ++col)
+            AssertIntEqual(board_ptr->cells[row][col].possibles, original.cells[row][col].possibles,
+                           "Outer checkpoint not restored");
+    AssertIntEqual(trail.size, 0, "Trail not emptied");
+    
+    FreeTrail(&trail);
+    free(board_ptr);
+}
+
+
+/**
+ Test that the bounded queue is first in, first out and reports when it is
+ full or empty.
+ */
+void TestBoundedQueue() {
+    PrintTestHeader("Bounded queue");
+    
+    struct BoundedQueue *queue = NewBoundedQueue(2);
+    int items[5];
+    void *item;
+    
+    AssertIntEqual(TryPopQueue(queue, &item), false, "Pop from empty queue");
+    for (int round = 0; round < 3; ++round) {
+        for (int index = 0; index < 4; ++index)
+            AssertIntEqual(TryPushQueue(queue, &items[index]), true, "Push to queue with room failed");
+        AssertIntEqual(TryPushQueue(queue, &items[4]), false, "Push to full queue");
+        for (int index = 0; index < 4; ++index) {
+            AssertIntEqual(TryPopQueue(queue, &item), true, "Pop from non-empty queue failed");
+            AssertIntEqual(item == &items[index], true, "Items out of order");
+        }
+        AssertIntEqual(TryPopQueue(queue, &item), false, "Pop from empty queue");
+    }
+    
+    FreeBoundedQueue(queue);
+}
+
+
+/**
+ Test that the batch pipeline answers every line in input order, with more
+ batches than buffers so that the buffers are recycled and the writer has to
+ reorder.
+ */
+void TestPipeline() {
+    PrintTestHeader("Pipeline");
+    
+    char const *lines[] = {
+        "..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1.......",
+        "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4..",
+        "not a puzzle",
+        "..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1........",
+    };
+    int num_lines = 4 * 25;
+    FILE *input = tmpfile();
+    FILE *output = tmpfile();
+    
+    for (int index = 0; index < num_lines; ++index)
+        fprintf(input, "%s\n", lines[index % 4]);
+    rewind(input);
+    
+    struct PipelineOptions options = DefaultPipelineOptions();
+    struct PipelineStats stats;
+    options.num_workers = 3;
+    options.batch_size = 3;
+    options.num_batches = 2;
+    AssertIntEqual(RunPipeline(input, output, &options, &stats), 0, "Pipeline failed");
+    AssertIntEqual((int) stats.puzzles, num_lines, "Wrong number of puzzles");
+    AssertIntEqual((int) stats.solved, num_lines / 2, "Wrong number of solved puzzles");
+    AssertIntEqual((int) stats.malformed, num_lines / 2, "Wrong number of malformed lines");
+    AssertIntEqual((int) stats.dispatch.solved[kTierClusters], num_lines / 4, "Easy puzzles not solved by logic");
+    AssertIntEqual((int) stats.dispatch.solved[kTierSearch], num_lines / 4, "Hard puzzles not solved by search");
+    
+    struct SolveScheduler scheduler;
+    struct DispatchStats dispatch;
+    struct SudokuBoard board;
+    char expected[2][82];
+    char actual[128];
+    InitSolveScheduler(&scheduler);
+    InitDispatchStats(&dispatch);
+    for (int index = 0; index < 2; ++index) {
+        BoardFromString(&board, lines[index]);
+        SolveBoardTiered(&board, &scheduler, &dispatch);
+        BoardToString(&board, expected[index]);
+        expected[index][81] = '\0';
+    }
+    
+    rewind(output);
+    for (int index = 0; index < num_lines; ++index) {
+        if (fgets(actual, sizeof actual, output) == NULL) {
+            AssertIntEqual(index, num_lines, "Output too short");
+            break;
+        }
+        actual[strcspn(actual, "\n")] = '\0';
+        char const *wanted = index % 4 < 2 ? expected[index % 4] : "";
+        AssertIntEqual(strcmp(actual, wanted), 0, "Wrong output line");
+    }
+    AssertIntEqual(fgets(actual, sizeof actual, output) == NULL, true, "Output too long");
+    
+    fclose(input);
+    fclose(output);
+}
+
+
+/**
+ Test that grid validation finds the lowest failing unit or clue, and that the
+ batch version agrees with checking grids one at a time.
+ */
+void TestValidateGrids() {
+    PrintTestHeader("Validate grids");
+    
+    char const *solution =
+        "812753649" "943682175" "675491283"
+        "154237896" "369845721" "287169534"
+        "521974368" "438526917" "796318452";
+    char const *puzzle =
+        "8........" "..36....." ".7..9.2.."
+        ".5...7..." "....457.." "...1...3."
+        "..1....68" "..85...1." ".9....4..";
+    int num_grids = 4 * 9 + 1; // not a whole number of vectors
+    char *grids = malloc(num_grids * 81);
+    char *clues = malloc(num_grids * 81);
+    int *expected = malloc(num_grids * sizeof(int));
+    int *results = malloc(num_grids * sizeof(int));
+    
+    for (int index = 0; index < num_grids; ++index) {
+        char *grid = grids + index * 81;
+        memcpy(grid, solution, 81);
+        memcpy(clues + index * 81, puzzle, 81);
+        
+        switch (index % 4) {
+            case 0:
+                expected[index] = kGridValid;
+                break;
+            case 1: // rows stay intact, column 0 or 1 gets a duplicate
+                grid[0] = solution[1];
+                grid[1] = solution[0];
+                expected[index] = 9;
+                break;
+            case 2: // an empty cell in row 4, column 4, square 4
+                grid[4 * 9 + 4] = '.';
+                expected[index] = 4;
+                break;
+            case 3: // a clue that the (valid) grid does not match
+                clues[index * 81 + 80] = '1';
+                expected[index] = kGridClueMismatch;
+                break;
+        }
+    }
+    
+    ValidateGrids(grids, clues, num_grids, results);
+    for (int index = 0; index < num_grids; ++index) {
+        AssertIntEqual(ValidateGrid(grids + index * 81, clues + index * 81), expected[index],
+                       "Wrong result for single grid");
+        AssertIntEqual(results[index], expected[index], "Wrong result for grid in batch");
+    }
+    
+    ValidateGrids(grids, NULL, num_grids, results);
+    for (int index = 0; index < num_grids; ++index)
+        AssertIntEqual(results[index], index % 4 == 3 ? kGridValid : expected[index],
+                       "Wrong result without clues");
+    
+    free(grids);
+    free(clues);
+    free(expected);
+    free(results);
+}
+
+
+/**
+ Assert that a puzzle has exactly one solution under a layout, and which.
+
+ @param puzzle The clues in the format of BoardFromString().
+ @param layout The units and cages of the puzzle.
+ @param solution The expected solution in the same format.
+ @param error_message The string to print when the assertion fails.
+ */
+void AssertUniqueSolution(char const *puzzle, struct UnitLayout const *layout, char const *solution,
+                          char *error_message) {
+    struct SudokuBoard board;
+    struct SearchOptions options = DefaultSearchOptions();
+    char text[81];
+    
+    options.max_solutions = 2;
+    options.layout = layout;
+    BoardFromString(&board, puzzle);
+    AssertIntEqual(SearchBoard(&board, &options).num_solutions, 1, error_message);
+    BoardToString(&board, text);
+    AssertIntEqual(memcmp(text, solution, 81), 0, error_message);
+}
+
+
+/**
+ Test diagonal, jigsaw and killer puzzles, each of which is ambiguous or
+ unsolvable without its extra constraints.
+ */
+void TestVariantLayouts() {
+    PrintTestHeader("Variant layouts");
+    
+    struct UnitLayout layout;
+    struct SudokuBoard board;
+    struct SearchOptions options = DefaultSearchOptions();
+    options.max_solutions = 2;
+    
+    char const *diagonal_puzzle =
+        ".......98" "..6.894.." "1..5....." ".......8." "4..2....7" "........." "...9.48.." "6........" ".3..75...";
+    char const *diagonal_solution =
+        "254367198" "376189425" "189542673" "567491382" "491238567" "823756914" "715924836" "642813759" "938675241";
+    BoardFromString(&board, diagonal_puzzle);
+    AssertIntEqual(SearchBoard(&board, &options).num_solutions, 2, "Diagonal puzzle unique without diagonals");
+    InitClassicLayout(&layout);
+    AssertIntEqual(AddDiagonalUnits(&layout), true, "Could not add diagonals");
+    AssertUniqueSolution(diagonal_puzzle, &layout, diagonal_solution, "Diagonal puzzle not solved");
+    
+    char const *jigsaw_regions =
+        "111122373" "211229333" "171222333" "444555966" "444555666" "488555666" "777888968" "379884999" "177984279";
+    char const *jigsaw_puzzle =
+        "..4.6...." "........." "......6.." ".......8." "..7..5342" "....1...." "....2...." "..1...2.7" "8..4.....";
+    char const *jigsaw_solution =
+        "254367198" "376189425" "189542673" "492736581" "617895342" "538214769" "763921854" "941658237" "825473916";
+    AssertIntEqual(InitJigsawLayout(&layout, "1111111112"), false, "Short region accepted");
+    AssertIntEqual(InitJigsawLayout(&layout, jigsaw_regions), true, "Jigsaw regions rejected");
+    AssertUniqueSolution(jigsaw_puzzle, &layout, jigsaw_solution, "Jigsaw puzzle not solved");
+    
+    // Traced changes name the regions as regions, and the squares of a
+    // classic solve as squares.
+    struct TraceRing *ring = NewTraceRing(16);
+    int region_events = 0, square_events = 0;
+    BoardFromString(&board, jigsaw_puzzle);
+    AttachTraceRing(ring);
+    SolveBoardWithLayout(&board, &layout);
+    BoardFromString(&board, jigsaw_puzzle);
+    SolveBoard(&board);
+    AttachTraceRing(NULL);
+    for (uint64_t index = 0; index < ring->count && index <= ring->mask; ++index) {
+        struct TraceEvent const *event = &ring->events[index];
+        if (event->unit >= 2 * kMaxNumber && event->unit < 3 * kMaxNumber) {
+            region_events += (event->flags & kTraceRegionUnits) != 0;
+            square_events += (event->flags & kTraceRegionUnits) == 0;
+        }
+    }
+    AssertIntEqual(region_events > 0 && square_events > 0, 1, "Regions and squares told apart in the trace");
+    FreeTraceRing(ring);
+    
+    // Each cage is a letter; its sum is at the letter's position in the alphabet
+    // (lower case first). The puzzle has no clues at all and its solution is
+    // the same grid as the jigsaw's.
+    char const *cage_map =
+        "yyyykkkqs" "ppCCfxqqg" "aaaffxxgg" "odmmnnbbg" "ddAAnBbev" "jdrttllev" "jurrrFlev" "ccwwwhhev" "cEiiiDhzz";
+    int const cage_sums[] = {
+        18, 16, 21, 19, 18, 17, 16, 19, 16, 12, 14, 19, 9, 18, 4, 10, 15, 22, 8, 3, 6, 22, 12, 17, 14, 7,
+        15, 5, 7, 3, 2, 1
+    };
+    char const *cage_names = "abcdefghijklmnopqrstuvwxyzABCDEF";
+    InitClassicLayout(&layout);
+    AssertIntEqual(AddCage(&layout, 2, 2, (int []) {0, 1}), false, "Impossible cage accepted");
+    AssertIntEqual(AddCage(&layout, 3, 2, (int []) {0, 81}), false, "Cage off the board accepted");
+    AssertIntEqual(AddCage(&layout, 3, 2, (int []) {-1, 0}), false, "Cage off the board accepted");
+    AssertIntEqual(AddCage(&layout, 6, 3, (int []) {4, 5, 4}), false, "Cage with a repeated cell accepted");
+    AssertIntEqual(layout.num_cages, 0, "Rejected cage was added");
+    for (int cage_num = 0; cage_num < 32; ++cage_num) {
+        int cells[9];
+        int size = 0;
+        for (int cell = 0; cell < 81; ++cell)
+            if (cage_map[cell] == cage_names[cage_num])
+                cells[size++] = cell;
+        AssertIntEqual(AddCage(&layout, cage_sums[cage_num], size, cells), true, "Cage rejected");
+    }
+    AssertUniqueSolution("........." "........." "........." "........." "........." "........." "........."
+                         "........." ".........", &layout, jigsaw_solution, "Killer puzzle not solved");
+}
+
+
+/**
+ Test that a trace of a search replays through the solution it found,
+ that every event is labelled with the technique that made it, and that a
+ full ring keeps only the newest events.
+ */
+void TestTraceRing() {
+    PrintTestHeader("Trace ring");
+    
+    char const *puzzle =
+        "8........" "..36....." ".7..9.2.."
+        ".5...7..." "....457.." "...1...3."
+        "..1....68" "..85...1." ".9....4..";
+    struct SudokuBoard board, replay;
+    struct SearchOptions options = DefaultSearchOptions();
+    struct TraceRing *ring = NewTraceRing(20);
+    int techniques[kNumTraceTechniques] = {0};
+    int mismatches = 0;
+    bool reached_solution = false;
+    
+    AttachTraceRing(ring);
+    BoardFromString(&board, puzzle);
+    AssertIntEqual((int) ring->count, 21, "one event per clue");
+    struct SearchResult result = SearchBoard(&board, &options);
+    AttachTraceRing(NULL);
+    AssertIntEqual(result.num_solutions, 1, "traced search finds the solution");
+    
+    ClearBoard(&replay);
+    for (uint64_t index = 0; index < ring->count; ++index) {
+        struct TraceEvent const *event = &ring->events[index];
+        struct SudokuCell *cell = &replay.cells[event->cell / kMaxNumber][event->cell % kMaxNumber];
+        mismatches += cell->possibles != event->before;
+        cell->possibles = event->after;
+        ++techniques[event->technique];
+        int same = 0;
+        for (int other = 0; other < kMaxNumber * kMaxNumber; ++other)
+            same += replay.cells[other / kMaxNumber][other % kMaxNumber].possibles ==
+                board.cells[other / kMaxNumber][other % kMaxNumber].possibles;
+        reached_solution |= same == kMaxNumber * kMaxNumber;
+    }
+    // The search rolls its board back after finding the solution, so the
+    // replay passes through the solution rather than ending on it.
+    AssertIntEqual(mismatches, 0, "every event starts from the replayed value");
+    AssertIntEqual(reached_solution, true, "replay reaches the solution");
+    AssertIntEqual(techniques[kTraceInput], 21, "clues traced as input");
+    AssertIntEqual(techniques[kTraceSingles] > 0 && techniques[kTraceClusters] > 0, 1, "logic traced");
+    AssertIntEqual(techniques[kTraceBranch] > 0 && techniques[kTraceUndo] > 0, 1, "search traced");
+    FreeTraceRing(ring);
+    
+    // A ring of 16 events keeps the last 16, oldest first in the file.
+    char path[] = "/tmp/sudoku-trace-XXXXXX";
+    int fd = mkstemp(path);
+    ring = NewTraceRing(4);
+    AttachTraceRing(ring);
+    BoardFromString(&board, puzzle);
+    AttachTraceRing(NULL);
+    AssertIntEqual(WriteTraceFile(ring, path), true, "trace written");
+    
+    FILE *file = fopen(path, "rb");
+    char header[32];
+    struct TraceEvent events[17];
+    AssertIntEqual((int) fread(header, 1, sizeof header, file), 32, "trace header read");
+    AssertIntEqual((int) fread(events, sizeof events[0], 17, file), 16, "last 16 events kept");
+    fclose(file);
+    AssertIntEqual(events[0].cell, 2 * kMaxNumber + 6, "oldest kept event is the sixth clue");
+    AssertIntEqual(events[15].cell, 8 * kMaxNumber + 6, "newest kept event is the last clue");
+    
+    close(fd);
+    remove(path);
+    FreeTraceRing(ring);
+}
+
+
+/**
+ Test that solutions stored through one handle are found through another, that
+ a full store turns solutions away but still answers, that a second pipeline
+ run answers from the store, and that a file that is not a store is refused.
+ */
+void TestSolutionStore() {
+    PrintTestHeader("Solution store");
+    
+    char const *puzzle = "..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1.......";
+    char path[] = "/tmp/sudoku-store-XXXXXX";
+    int fd = mkstemp(path);
+    struct SolveScheduler scheduler;
+    struct SudokuBoard board, solution, found;
+    char expected[81], actual[81];
+    
+    InitSolveScheduler(&scheduler);
+    BoardFromString(&board, puzzle);
+    solution = board;
+    SolveBoardScheduled(&solution, &scheduler);
+    BoardToString(&solution, expected);
+    
+    struct SolutionStore *store = OpenSolutionStore(path, 4);
+    struct SolutionStore *other = OpenSolutionStore(path, 10);
+    AssertIntEqual(store != NULL && other != NULL, true, "store opened twice");
+    AssertIntEqual(LookupSolution(store, &board, &found), false, "empty store knows nothing");
+    AssertIntEqual(StoreSolution(store, &board, &solution), true, "solution stored");
+    AssertIntEqual(LookupSolution(other, &board, &found), true, "solution seen through another handle");
+    BoardToString(&found, actual);
+    AssertIntEqual(memcmp(actual, expected, 81), 0, "stored solution intact");
+    
+    // Puzzles made by opening one cell of the solution fill the 16 slots.
+    int stored = 0;
+    for (int cell = 0; cell < 40; ++cell) {
+        struct SudokuBoard open_cell = solution;
+        SetCellPossibles(&open_cell, cell / kMaxNumber, cell % kMaxNumber, kAllBits);
+        stored += StoreSolution(other, &open_cell, &solution);
+    }
+    AssertIntEqual(stored, 15, "full store turns solutions away");
+    AssertIntEqual(StoreSolution(store, &board, &solution), true, "known puzzle still accepted");
+    AssertIntEqual(LookupSolution(store, &board, &found), true, "full store still answers");
+    CloseSolutionStore(other);
+    CloseSolutionStore(store);
+    
+    // Slots that do not hold a solved board are not believed.
+    remove(path);
+    store = OpenSolutionStore(path, 4);
+    StoreSolution(store, &board, &board);
+    AssertIntEqual(LookupSolution(store, &board, &found), false, "unsolved grid refused");
+    struct SudokuBoard open_cell = solution;
+    SetCellPossibles(&open_cell, 0, 0, kAllBits);
+    StoreSolution(store, &open_cell, &solution);
+    int corrupt_fd = open(path, O_RDWR);
+    uint8_t slot[96];             // 64-byte header, 96-byte slots: tag, clues, solution
+    for (off_t offset = 64; pread(corrupt_fd, slot, sizeof slot, offset) == sizeof slot; offset += sizeof slot)
+        if (memcmp(slot, (uint8_t [8]) {0}, 8) != 0)
+            pwrite(corrupt_fd, (uint8_t []) {0xff}, 1, offset + 8 + 41);
+    close(corrupt_fd);
+    AssertIntEqual(LookupSolution(store, &open_cell, &found), false, "value above kMaxNumber refused");
+    CloseSolutionStore(store);
+    
+    // Nor are grids of digits that break a unit or a clue.
+    char const *shifted =           // a valid grid, but not the puzzle's solution
+        "123456789" "456789123" "789123456" "234567891" "567891234" "891234567" "345678912" "678912345" "912345678";
+    char broken[81];                // the solution with an open cell changed, which breaks its units
+    memcpy(broken, expected, 81);
+    broken[0] = (char) ('1' + (broken[0] - '0') % kMaxNumber);
+    char const *wrong_grids[2] = {broken, shifted};
+    for (int grid_num = 0; grid_num < 2; ++grid_num) {
+        remove(path);
+        store = OpenSolutionStore(path, 4);
+        StoreSolution(store, &board, &solution);
+        uint8_t packed[41];
+        for (int cell = 0; cell < 81; ++cell) {
+            int value = wrong_grids[grid_num][cell] - '0';
+            if (cell % 2 == 0)
+                packed[cell / 2] = (uint8_t) value;
+            else
+                packed[cell / 2] |= (uint8_t) (value << 4);
+        }
+        corrupt_fd = open(path, O_RDWR);
+        for (off_t offset = 64; pread(corrupt_fd, slot, sizeof slot, offset) == sizeof slot; offset += sizeof slot)
+            if (memcmp(slot, (uint8_t [8]) {0}, 8) != 0)
+                pwrite(corrupt_fd, packed, sizeof packed, offset + 8 + 41);
+        close(corrupt_fd);
+        AssertIntEqual(LookupSolution(store, &board, &found), false,
+                       grid_num == 0 ? "grid with a repeated digit refused" : "grid against the clues refused");
+        CloseSolutionStore(store);
+    }
+    
+    // A second run of the pipeline answers every solved puzzle from the store.
+    remove(path);
+    store = OpenSolutionStore(path, 8);
+    struct PipelineOptions options = DefaultPipelineOptions();
+    struct PipelineStats stats[2];
+    options.num_workers = 2;
+    options.store = store;
+    for (int run = 0; run < 2; ++run) {
+        FILE *input = tmpfile();
+        FILE *output = tmpfile();
+        fprintf(input, "%s\n%s\n", puzzle, puzzle);
+        rewind(input);
+        RunPipeline(input, output, &options, &stats[run]);
+        fclose(input);
+        fclose(output);
+    }
+    AssertIntEqual((int) stats[0].solved, 2, "first run solves");
+    AssertIntEqual((int) stats[1].solved, 2, "second run solves");
+    AssertIntEqual((int) stats[1].known, 2, "second run answers from the store");
+    CloseSolutionStore(store);
+    
+    FILE *file = fopen(path, "wb");
+    fputs("not a solution store", file);
+    fclose(file);
+    AssertIntEqual(OpenSolutionStore(path, 4) == NULL, true, "other files refused");
+    
+    close(fd);
+    remove(path);
+}
+
+
+/**
+ Test that each puzzle is finished by the cheapest tier that can finish it,
+ that contradictions are caught, and that the answers agree with the other
+ solvers.
+ */
+void TestSolveBoardTiered() {
+    PrintTestHeader("Tiered dispatch");
+    
+    char const *solution = "195674832624398175837521496963147528571283964482956317248739651356812749719465283";
+    char const *hard = "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4..";
+    char puzzle[82], expected[81], actual[81];
+    struct SolveScheduler scheduler;
+    struct DispatchStats stats;
+    struct SudokuBoard board;
+    
+    InitSolveScheduler(&scheduler);
+    InitDispatchStats(&stats);
+    
+    // Blanking the main diagonal leaves a naked single in every blank cell.
+    strcpy(puzzle, solution);
+    for (int index = 0; index < kMaxNumber; ++index)
+        puzzle[index * kMaxNumber + index] = '.';
+    BoardFromString(&board, puzzle);
+    AssertIntEqual(SolveBoardTiered(&board, &scheduler, &stats), true, "singles puzzle solved");
+    BoardToString(&board, actual);
+    AssertIntEqual(memcmp(actual, solution, 81), 0, "singles puzzle solution");
+    AssertIntEqual((int) stats.solved[kTierSingles], 1, "solved by singles");
+    
+    struct SudokuBoard *example = example1();
+    AssertIntEqual(SolveBoardTiered(example, &scheduler, &stats), true, "example solved");
+    BoardToString(example, actual);
+    AssertIntEqual(memcmp(actual, solution, 81), 0, "example solution");
+    AssertIntEqual((int) stats.solved[kTierClusters], 1, "solved by clusters");
+    free(example);
+    
+    struct SearchOptions options = DefaultSearchOptions();
+    BoardFromString(&board, hard);
+    SearchBoard(&board, &options);
+    BoardToString(&board, expected);
+    BoardFromString(&board, hard);
+    AssertIntEqual(SolveBoardTiered(&board, &scheduler, &stats), true, "hard puzzle solved");
+    BoardToString(&board, actual);
+    AssertIntEqual(memcmp(actual, expected, 81), 0, "hard puzzle solution");
+    AssertIntEqual((int) stats.solved[kTierSearch], 1, "solved by search");
+    
+    // Two 5s in the first row; then a first row whose open cell has no value left.
+    strcpy(puzzle, hard);
+    puzzle[1] = puzzle[2] = '5';
+    BoardFromString(&board, puzzle);
+    AssertIntEqual(PropagateSingles(&board), false, "repeated clue caught by singles");
+    BoardFromString(&board, puzzle);
+    AssertIntEqual(SolveBoardTiered(&board, &scheduler, &stats), false, "repeated clue has no solution");
+    strcpy(puzzle, "12345678.........9" "...............................................................");
+    BoardFromString(&board, puzzle);
+    AssertIntEqual(SolveBoardTiered(&board, &scheduler, &stats), false, "empty cell has no solution");
+    AssertIntEqual((int) stats.unsolved, 2, "unsolved counted");
+    
+    // The empty grid has countless solutions: none of them is reported.
+    ClearBoard(&board);
+    AssertIntEqual(SolveBoardTiered(&board, &scheduler, &stats), false, "ambiguous puzzle not solved");
+    AssertIntEqual(IsBoardSolved(&board), false, "ambiguous puzzle left open");
+    AssertIntEqual((int) stats.ambiguous, 1, "ambiguous counted");
+    AssertIntEqual((int) stats.solved[kTierSearch], 1, "ambiguous not counted as solved");
+    AssertIntEqual((int) stats.puzzles, 6, "puzzles counted");
+}
+
+
+/**
+ Test that histogram percentiles are within the bucket precision and that
+ histograms add up.
+ */
+void TestLatencyHistogram() {
+    PrintTestHeader("Latency histogram");
+    
+    struct LatencyHistogram *histogram = malloc(sizeof(struct LatencyHistogram));
+    struct LatencyHistogram *other = malloc(sizeof(struct LatencyHistogram));
+    InitLatencyHistogram(histogram);
+    InitLatencyHistogram(other);
+    
+    AssertIntEqual((int) LatencyPercentile(histogram, 50.0), 0, "empty histogram");
+    for (int64_t value = 1; value <= 10000; ++value)
+        RecordLatency(value <= 5000 ? histogram : other, value * 1000);
+    AddLatencyHistogram(histogram, other);
+    
+    int64_t percentiles[3] = {
+        LatencyPercentile(histogram, 50.0), LatencyPercentile(histogram, 99.0), LatencyPercentile(histogram, 99.9)
+    };
+    int64_t expected[3] = {5000000, 9900000, 9990000};
+    for (int index = 0; index < 3; ++index) {
+        AssertIntEqual(percentiles[index] >= expected[index], true, "percentile not below the exact value");
+        AssertIntEqual(percentiles[index] <= expected[index] + expected[index] / 32, true, "percentile within 3%");
+    }
+    AssertIntEqual((int) LatencyPercentile(histogram, 100.0), 10000000, "100th percentile is the maximum");
+    AssertIntEqual((int) histogram->total, 10000, "counts added");
+    
+    InitLatencyHistogram(other);
+    for (int64_t value = 0; value < 32; ++value)
+        RecordLatency(other, value);
+    AssertIntEqual((int) LatencyPercentile(other, 50.0), 15, "small values are exact");
+    RecordLatency(other, (int64_t) 1 << 62);
+    AssertIntEqual(LatencyPercentile(other, 100.0) == (int64_t) 1 << 62, true, "huge values are kept");
+    
+    free(histogram);
+    free(other);
+}
+
+
+/**
+ Test that generated puzzles are unique and finished by the tier they were
+ made for, and that an open-loop run counts latency from when each puzzle was
+ due: when the schedule outruns the solver, the wait shows up in the latency
+ but not in the service time.
+ */
+void TestRunLoad() {
+    PrintTestHeader("Load generator");
+    
+    uint64_t rng_state = 42;
+    char puzzle[81];
+    struct SudokuBoard board;
+    struct SearchOptions search_options = DefaultSearchOptions();
+    search_options.max_solutions = 2;
+    struct SolveScheduler scheduler;
+    struct DispatchStats stats;
+    InitSolveScheduler(&scheduler);
+    InitDispatchStats(&stats);
+    for (int index = 0; index < 30; ++index) {
+        enum DispatchTier tier = (enum DispatchTier) (index % kNumDispatchTiers);
+        GenerateLoadPuzzle(&rng_state, tier, puzzle);
+        AssertIntEqual(BoardFromString(&board, puzzle), true, "generated puzzle is well-formed");
+        AssertIntEqual(SearchBoard(&board, &search_options).num_solutions, 1, "generated puzzle has one solution");
+        BoardFromString(&board, puzzle);
+        long before = stats.solved[tier];
+        SolveBoardTiered(&board, &scheduler, &stats);
+        AssertIntEqual((int) (stats.solved[tier] - before), 1, "generated puzzle finished by its tier");
+    }
+    
+    struct LoadOptions options = DefaultLoadOptions();
+    struct LoadResult *result = malloc(sizeof(struct LoadResult));
+    options.num_threads = 2;
+    options.seconds = 0.1;
+    AssertIntEqual(RunLoad(&options, result), 0, "closed-loop run");
+    AssertIntEqual(result->completed > 0 && result->completed == result->dispatch.puzzles, true, "puzzles counted");
+    AssertIntEqual((int) result->latency.total, (int) result->completed, "every puzzle timed");
+    
+    // Easy puzzles, due every 100 ns: the schedule falls far behind.
+    options.num_threads = 1;
+    options.rate = 1e7;
+    options.hard_fraction = 0.0;
+    options.cluster_fraction = 0.0;
+    AssertIntEqual(RunLoad(&options, result), 0, "open-loop run");
+    AssertIntEqual(result->behind > 0, true, "puzzles behind schedule counted");
+    AssertIntEqual(result->latency.total == result->completed + result->behind, true, "puzzles behind schedule recorded");
+    AssertIntEqual(LatencyPercentile(&result->latency, 50.0) > 2 * LatencyPercentile(&result->service, 50.0), true,
+                   "queueing counted in latency");
+    
+    char const *corpus[1] = {"..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1......."};
+    options = DefaultLoadOptions();
+    options.num_threads = 1;
+    options.seconds = 0.05;
+    options.corpus = corpus;
+    options.corpus_size = 1;
+    AssertIntEqual(RunLoad(&options, result), 0, "corpus run");
+    AssertIntEqual(result->completed == result->dispatch.solved[kTierClusters], true, "corpus puzzles solved");
+    
+    free(result);
+}
+
+
+struct TestServerArgs {
+    char const *socket_path;
+    struct ServerOptions options;
+    int result;
+};
+
+
+/**
+ Run the server for TestServer(). Never returns.
+
+ @param arg Pointer to struct TestServerArgs.
+ @return NULL.
+ */
+static void *TestServerMain(void *arg) {
+    struct TestServerArgs *args = arg;
+    args->result = RunServer(args->socket_path, &args->options);
+    return NULL;
+}
+
+
+/**
+ Connect to the server at socket_path, retrying while it starts up.
+
+ @param socket_path File system path of the socket.
+ @return The connected socket, or -1.
+ */
+int ConnectTestServer(char const *socket_path) {
+    struct sockaddr_un address;
+    
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    int fd = -1;
+    for (int attempt = 0; attempt < 200 && fd < 0; ++attempt) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *) &address, sizeof address) != 0) {
+            close(fd);
+            fd = -1;
+            struct timespec pause = {0, 10000000};
+            nanosleep(&pause, NULL);
+        }
+    }
+    
+    return fd;
+}
+
+
+/**
+ Read one response frame of the server.
+
+ @param fd The connected socket.
+ @param frame Receives the 94 bytes of the frame.
+ @return false if the connection ended first.
+ */
+bool ReadTestServerFrame(int fd, unsigned char frame[4 + 90]) {
+    size_t got = 0;
+    
+    while (got < 4 + 90) {
+        ssize_t chunk = read(fd, frame + got, 4 + 90 - got);
+        if (chunk <= 0)
+            return false;
+        got += (size_t) chunk;
+    }
+    
+    return true;
+}
+
+
+/**
+ Test the server end to end over its socket: one request frame with more
+ puzzles than max_inflight, one of them malformed, must be answered by one
+ response frame per puzzle carrying the batch id, the puzzle's index, its
+ status and its board. A frame of impossible length must be answered with an
+ error frame before the connection closes, and SIGTERM must stop the server.
+ */
+void TestServer() {
+    PrintTestHeader("Server");
+    
+    enum { kNumPuzzles = 10, kMalformedIndex = 6 };
+    char const *puzzle = "..5.7.8....4...1..8.7....96...1...28...2..9..4..95..1.....39.513568.2....1.......";
+    char const *solution = "195674832624398175837521496963147528571283964482956317248739651356812749719465283";
+    static char socket_path[64];
+    static struct TestServerArgs args;
+    pthread_t thread;
+    
+    snprintf(socket_path, sizeof socket_path, "/tmp/sudoku-test-%d.sock", (int) getpid());
+    args.socket_path = socket_path;
+    args.options = DefaultServerOptions();
+    args.options.num_workers = 2;
+    args.options.max_inflight = 3;
+    if (pthread_create(&thread, NULL, TestServerMain, &args) != 0) {
+        AssertIntEqual(false, true, "server thread started");
+        return;
+    }
+    
+    int fd = ConnectTestServer(socket_path);
+    AssertIntEqual(fd >= 0, true, "connected to server");
+    if (fd < 0) {
+        pthread_detach(thread);
+        return;
+    }
+    
+    char request[8 + kNumPuzzles * 81];
+    uint32_t header[2] = {htonl(4 + kNumPuzzles * 81), htonl(7)};
+    memcpy(request, header, sizeof header);
+    for (int index = 0; index < kNumPuzzles; ++index)
+        memcpy(request + 8 + index * 81, index == kMalformedIndex ? solution + 1 : puzzle, 81);
+    request[8 + kMalformedIndex * 81 + 80] = 'x';
+    AssertIntEqual(write(fd, request, sizeof request) == (ssize_t) sizeof request, true, "request sent");
+    
+    bool seen[kNumPuzzles] = {false};
+    for (int frame_num = 0; frame_num < kNumPuzzles; ++frame_num) {
+        unsigned char frame[4 + 90];
+        if (!ReadTestServerFrame(fd, frame)) {
+            AssertIntEqual((int) frame_num, kNumPuzzles, "all responses received");
+            break;
+        }
+        
+        uint32_t words[3];
+        memcpy(words, frame, sizeof words);
+        int index = (int) ntohl(words[2]);
+        AssertIntEqual((int) ntohl(words[0]), 90, "response length");
+        AssertIntEqual((int) ntohl(words[1]), 7, "response batch id");
+        if (index < 0 || index >= kNumPuzzles || seen[index]) {
+            AssertIntEqual(index, -1, "response index valid and new");
+            continue;
+        }
+        seen[index] = true;
+        
+        if (index == kMalformedIndex) {
+            AssertIntEqual(frame[12], kServerStatusMalformed, "malformed puzzle reported");
+            AssertIntEqual(memcmp(frame + 13, request + 8 + index * 81, 81), 0, "malformed puzzle echoed");
+        }
+        else {
+            AssertIntEqual(frame[12], kServerStatusSolved, "puzzle solved");
+            AssertIntEqual(memcmp(frame + 13, solution, 81), 0, "solution sent");
+        }
+    }
+    
+    close(fd);
+    
+    // A frame too short for its batch id: one error frame, then end of stream.
+    fd = ConnectTestServer(socket_path);
+    uint32_t bad_header[2] = {htonl(2), 0};
+    unsigned char frame[4 + 90];
+    AssertIntEqual(write(fd, bad_header, sizeof bad_header) == (ssize_t) sizeof bad_header, true, "bad frame sent");
+    AssertIntEqual(ReadTestServerFrame(fd, frame), true, "bad frame answered");
+    uint32_t words[3];
+    memcpy(words, frame, sizeof words);
+    AssertIntEqual(ntohl(words[2]) == kServerIndexNone, true, "bad frame index");
+    AssertIntEqual(frame[12], kServerStatusBadFrame, "bad frame status");
+    AssertIntEqual(read(fd, frame, 1) == 0, true, "connection closed after bad frame");
+    close(fd);
+    
+    pthread_kill(thread, SIGTERM);
+    pthread_join(thread, NULL);
+    AssertIntEqual(args.result, 0, "server stopped by SIGTERM");
+    AssertIntEqual(access(socket_path, F_OK), -1, "socket removed");
+}
@@ -17,5 +17,24 @@ void TestFilterCellsByClusters();
 void TestFindLineClusters();
 void TestFindLineClusters2();
 void TestFindLineClusters3();
+void TestFindLineClustersQuad();
+void TestFindLineClustersHidden();
+void TestBoardStringRoundTrip();
+void TestSolveBoardScheduled();
+void TestSearchBoard();
+void TestNextHint();
+void TestHiddenHint();
+void TestEditableBoard();
+void TestTrailCheckpoints();
+void TestBoundedQueue();
+void TestPipeline();
+void TestValidateGrids();
+void TestVariantLayouts();
+void TestTraceRing();
+void TestSolutionStore();
+void TestSolveBoardTiered();
+void TestLatencyHistogram();
+void TestRunLoad();
+void TestServer();
 
 #endif /* tests_h */
@@ -0,0 +1,257 @@
+//
+//  trace.c
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "trace.h"
+
+/*
+ Binary tracing of cell changes for post-mortems of single solves.
+
+ A thread that has a ring attached records every change made through
+ SetCellPossibles() and RestoreCheckpoint() as a fixed-size event, together
+ with the technique and unit that the code doing the change declared through
+ SetTraceContext(). Recording is a store into the thread's own ring, with no
+ locking, formatting or allocation; when the ring is full the oldest events are
+ overwritten. Threads without a ring pay for one test of a thread-local
+ pointer per change. The workers of a parallel SearchBoard() have no ring, so
+ their changes are not recorded; a search is traced with one thread.
+
+ A ring is written to a file as a small header followed by the kept events,
+ oldest first, in the byte order of the machine. PrintTraceFile() turns such a
+ file into a readable log.
+ */
+
+const int kTraceNoUnit = 255;
+const int kTraceRegionUnits = 1;
+
+_Thread_local struct TraceRing *current_trace_ring = NULL;
+static _Thread_local uint8_t current_technique = kTraceInput;
+static _Thread_local uint8_t current_unit = 255;
+static _Thread_local uint8_t current_flags = 0;
+
+static const char kTraceMagic[8] = {'S', 'D', 'K', 'T', 'R', 'A', 'C', 'E'};
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint64_t count;        // events recorded in total
+    uint64_t num_events;   // events in the file
+};
+
+
+/**
+ Allocate an empty ring.
+
+ @param log2_events The ring keeps the last 2^log2_events events.
+ @return Pointer to the ring; free with FreeTraceRing().
+ */
+struct TraceRing *NewTraceRing(int log2_events) {
+    struct TraceRing *ring = malloc(sizeof(struct TraceRing));
+    uint64_t capacity = (uint64_t) 1 << log2_events;
+
+    ring->events = malloc(capacity * sizeof(struct TraceEvent));
+    ring->mask = capacity - 1;
+    ring->count = 0;
+
+    return ring;
+}
+
+
+/**
+ Free a ring. It must not be attached to any thread.
+
+ @param ring The ring.
+ */
+void FreeTraceRing(struct TraceRing *ring) {
+    free(ring->events);
+    free(ring);
+}
+
+
+/**
+ Record the calling thread's changes into a ring from now on.
+
+ @param ring The ring, owned by the calling thread until detached; NULL stops tracing.
+ */
+void AttachTraceRing(struct TraceRing *ring) {
+    current_trace_ring = ring;
+}
+
+
+/**
+ Declare what the calling thread's following changes are made by.
+
+ @param technique The technique.
+ @param unit The unit or cage it is applied to, or kTraceNoUnit.
+ */
+void SetTraceContext(enum TraceTechnique technique, int unit) {
+    current_technique = (uint8_t) technique;
+    current_unit = (uint8_t) unit;
+}
+
+
+/**
+ Declare whether the calling thread's following unit numbers 18 ... 26 are
+ irregular regions (as in a jigsaw layout) rather than squares.
+
+ @param regions true for regions.
+ */
+void SetTraceRegions(bool regions) {
+    current_flags = regions ? (uint8_t) kTraceRegionUnits : 0;
+}
+
+
+/**
+ Record a cell change into the calling thread's ring, which must be attached.
+
+ @param cell The cell, numbered row * kMaxNumber + col.
+ @param before Possible values before the change.
+ @param after Possible values after the change.
+ */
+void RecordTraceEvent(int cell, unsigned int before, unsigned int after) {
+    struct TraceRing *ring = current_trace_ring;
+    struct TraceEvent *event = &ring->events[ring->count++ & ring->mask];
+
+    event->technique = current_technique;
+    event->unit = current_unit;
+    event->cell = (uint8_t) cell;
+    event->flags = current_flags;
+    event->before = (uint16_t) before;
+    event->after = (uint16_t) after;
+}
+
+
+/**
+ Write the events kept in a ring to a file.
+
+ @param ring The ring. Must not be recording at the same time.
+ @param path The file to create or overwrite.
+ @return false if the file could not be written.
+ */
+bool WriteTraceFile(struct TraceRing const *ring, char const *path) {
+    struct TraceFileHeader header;
+    uint64_t capacity = ring->mask + 1;
+    uint64_t first = ring->count > capacity ? ring->count - capacity : 0;
+
+    memcpy(header.magic, kTraceMagic, sizeof header.magic);
+    header.version = 1;
+    header.event_size = sizeof(struct TraceEvent);
+    header.count = ring->count;
+    header.num_events = ring->count - first;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+    // The kept events wrap around the end of the array at most once.
+    uint64_t start = first & ring->mask;
+    uint64_t to_end = capacity - start < header.num_events ? capacity - start : header.num_events;
+    ok = ok && fwrite(ring->events + start, sizeof(struct TraceEvent), to_end, file) == to_end;
+    ok = ok && fwrite(ring->events, sizeof(struct TraceEvent), header.num_events - to_end, file)
+        == header.num_events - to_end;
+
+    return fclose(file) == 0 && ok;
+}
+
+
+/**
+ Write the values of a bitfield as digits.
+
+ @param bits The bitfield.
+ @param text Buffer of at least kMaxNumber + 2 characters.
+ @return text.
+ */
+static char *FormatValues(unsigned int bits, char *text) {
+    char *end = text;
+
+    for (int digit = 1; digit <= kMaxNumber; ++digit)
+        if (bits & (1 << (digit - 1)))
+            *end++ = (char) ('0' + digit);
+    if (end == text)
+        *end++ = '-';
+    *end = '\0';
+
+    return text;
+}
+
+
+/**
+ Write the unit of an event in words.
+
+ @param event The event.
+ @param text Buffer of at least 16 characters.
+ @return text.
+ */
+static char *FormatUnit(struct TraceEvent const *event, char *text) {
+    static char const *unit_names[3] = {"row", "column", "square"};
+    int kind = event->unit / kMaxNumber;
+
+    if (event->unit == kTraceNoUnit)
+        text[0] = '\0';
+    else if (event->technique == kTraceCage)
+        sprintf(text, "cage %d", event->unit + 1);
+    else if (event->unit < 3 * kMaxNumber)
+        sprintf(text, "%s %d", kind == 2 && (event->flags & kTraceRegionUnits) ? "region" : unit_names[kind],
+                event->unit % kMaxNumber + 1);
+    else
+        sprintf(text, "unit %d", event->unit + 1);
+
+    return text;
+}
+
+
+/**
+ Print a trace file written by WriteTraceFile() as one line per event to
+ standard output.
+
+ @param path The trace file.
+ @return false if the file could not be read or is not a trace.
+ */
+bool PrintTraceFile(char const *path) {
+    static char const *technique_names[kNumTraceTechniques] = {
+        "input", "singles", "clusters", "cage", "branch", "undo"
+    };
+    struct TraceFileHeader header;
+    struct TraceEvent event;
+    char unit_text[16], before_text[16], after_text[16];
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    if (fread(&header, sizeof header, 1, file) != 1 || memcmp(header.magic, kTraceMagic, sizeof kTraceMagic) != 0 ||
+        header.version != 1 || header.event_size != sizeof(struct TraceEvent)) {
+        fclose(file);
+        return false;
+    }
+
+    uint64_t sequence = header.count - header.num_events;
+    if (sequence > 0)
+        printf("(%llu earlier events were overwritten)\n", (unsigned long long) sequence);
+
+    bool ok = true;
+    for (uint64_t index = 0; index < header.num_events; ++index, ++sequence) {
+        if (fread(&event, sizeof event, 1, file) != 1) {
+            ok = false;
+            break;
+        }
+
+        char const *technique = event.technique < kNumTraceTechniques ? technique_names[event.technique] : "?";
+        printf("%8llu  %-8s  %-9s  r%dc%d  %s -> %s\n", (unsigned long long) sequence, technique,
+               FormatUnit(&event, unit_text), event.cell / kMaxNumber + 1, event.cell % kMaxNumber + 1,
+               FormatValues(event.before, before_text), FormatValues(event.after, after_text));
+    }
+
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,64 @@
+//
+//  trace.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ What made a cell change.
+ */
+enum TraceTechnique {
+    kTraceInput,      // clues being set
+    kTraceSingles,    // a solved value removed from the rest of a unit
+    kTraceClusters,   // FindLineClusters()/FilterCellsByClusters() on a unit
+    kTraceCage,       // the killer cage rule
+    kTraceBranch,     // a value tried by the search
+    kTraceUndo,       // a change rolled back by RestoreCheckpoint()
+    kNumTraceTechniques
+};
+
+extern const int kTraceNoUnit;
+extern const int kTraceRegionUnits;
+
+/**
+ One cell change, 8 bytes.
+ */
+struct TraceEvent {
+    uint8_t technique;   // enum TraceTechnique
+    uint8_t unit;        // as in GetUnitCells() (or a layout's unit or cage number); kTraceNoUnit if none
+    uint8_t cell;        // row * kMaxNumber + col
+    uint8_t flags;       // kTraceRegionUnits if units 18 ... 26 are a layout's regions, not squares
+    uint16_t before;     // possible values before the change
+    uint16_t after;      // possible values after the change
+};
+
+/**
+ A ring of the most recent events of one thread. Only the thread that attached
+ a ring records into it, so a search traced as a whole must run on one thread.
+ */
+struct TraceRing {
+    struct TraceEvent *events;
+    uint64_t mask;       // capacity - 1
+    uint64_t count;      // events recorded in total; the last capacity of them are kept
+};
+
+extern _Thread_local struct TraceRing *current_trace_ring;
+
+struct TraceRing *NewTraceRing(int log2_events);
+void FreeTraceRing(struct TraceRing *ring);
+void AttachTraceRing(struct TraceRing *ring);
+void SetTraceContext(enum TraceTechnique technique, int unit);
+void SetTraceRegions(bool regions);
+void RecordTraceEvent(int cell, unsigned int before, unsigned int after);
+bool WriteTraceFile(struct TraceRing const *ring, char const *path);
+bool PrintTraceFile(char const *path);
+
+#endif /* trace_h */
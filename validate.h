@@ -0,0 +1,28 @@
+//
+//  validate.h
+//  Sudoku
+//
+//  Created by Rolf on 19/10/2026.
+//  Copyright © 2026 Rolf. All rights reserved.
+//
+
+#ifndef validate_h
+#define validate_h
+
+/**
+ Grids and clues are kMaxNumber * kMaxNumber characters in the format of
+ BoardFromString(). A grid must be filled with digits 1 ... 9; any other
+ character in clues (usually '.' or '0') marks a cell without a clue.
+
+ Validation results: kGridValid, a failing unit (as in GetUnitCells(); the
+ lowest-numbered one if several fail), or kGridClueMismatch if every unit is
+ complete but the grid disagrees with a clue.
+ */
+
+extern const int kGridValid;
+extern const int kGridClueMismatch;
+
+int ValidateGrid(char const *grid, char const *clues);
+void ValidateGrids(char const *grids, char const *clues, int num_grids, int *results);
+
+#endif /* validate_h */